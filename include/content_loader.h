@@ -0,0 +1,49 @@
+#ifndef CONTENT_LOADER_H
+#define CONTENT_LOADER_H
+
+#include "image_decoder.h"
+#include "tile_pyramid.h"
+#include <QImage>
+#include <QPointF>
+#include <QString>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+class QSvgRenderer;
+
+// Everything read and decoded from an image, SVG or presentation file
+// before it is shown. Producing it touches no widget or scene, so it can
+// run on a worker thread; the GUI thread only turns it into scene items.
+struct LoadedContent {
+  enum class Kind { Raster, Tiled, Svg };
+
+  QString filePath;
+  Kind kind = Kind::Raster;
+  QString imageFormat;
+
+  QImage image;                          // Raster, in a display format
+  std::shared_ptr<ImageDecoder> decoder; // Tiled
+  qint64 tileCacheBytes = 0;             // Tiled
+  // Tiled, when its first tiles were decoded ahead of time
+  std::shared_ptr<TilePyramid> pyramid;
+  QString svgContent;                    // Svg, nested <svg> flattened
+  // Svg, parsed and owned by the GUI thread
+  std::shared_ptr<QSvgRenderer> svgRenderer;
+
+  // Presentation points; empty for plain images
+  std::vector<std::tuple<QPointF, qreal>> points;
+
+  QString error; // Set instead of the above when loading failed
+  qreal decodeMs = 0.0; // Time spent in loadContent()
+  // Memory held by the decoded content, not counting tile caches
+  qint64 decodedBytes = 0;
+  bool ok() const { return error.isEmpty(); }
+};
+
+// Reads and decodes `filePath`. Safe to call from any thread. With
+// `maxDecodedBytes` > 0, content whose header says it needs more memory
+// than that fails before it is decoded.
+LoadedContent loadContent(const QString &filePath, qint64 maxDecodedBytes = 0);
+
+#endif // CONTENT_LOADER_H
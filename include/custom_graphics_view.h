@@ -1,34 +1,94 @@
 #ifndef CUSTOM_GRAPHICS_VIEW_H
 #define CUSTOM_GRAPHICS_VIEW_H
 
+#include "render_thread.h"
 #include <QGraphicsView>
+#include <QPixmap>
 #include <QSize>
+#include <QTimer>
 #include <QWheelEvent>
+#include <memory>
 
 class CustomGraphicsView : public QGraphicsView {
   Q_OBJECT
 
 public:
+  // Draft frames are drawn without antialiasing or smooth pixmap scaling,
+  // which also lets tiled items fall back to coarser pyramid levels
+  enum class RenderQuality { Draft, Full };
+
+  // Direct paints the scene in paintEvent(). Parallel paints the render
+  // source in horizontal bands on all cores. Threaded paints it on a worker
+  // thread and paintEvent() only blits the latest frame.
+  enum class RenderMode { Direct, Parallel, Threaded };
+
   explicit CustomGraphicsView(QWidget *parent = nullptr);
   void setInitialZoom();
-  void setZoom(qreal zoom);
+  void setViewState(const QPointF &center, qreal zoom);
   qreal getZoom() const { return m_currentZoom; }
   void setOriginalImageSize(const QSize &size);
   QPointF mapToImageCoordinates(const QPointF &viewPoint) const;
   QPointF mapFromImageCoordinates(const QPointF &imagePoint) const;
 
+  // Marks the view as moving: frames are drafted until no motion has been
+  // reported for the settle delay, then the view repaints at full quality
+  void beginMotion();
+  void setSettleDelay(int msecs) { m_settleTimer.setInterval(msecs); }
+  RenderQuality renderQuality() const { return m_renderQuality; }
+
+  // The scene area shown for the view centered on `center` at `zoom` with
+  // the current viewport, and a full-quality render of it from `source`
+  QRectF sceneRectFor(const QPointF &center, qreal zoom) const;
+  RenderThread::Request snapshotRequest(std::shared_ptr<RenderSource> source,
+                                        const QRectF &sceneRect) const;
+  // Renders a snapshotRequest(); safe to call from any thread
+  static QImage renderSnapshot(const RenderThread::Request &request);
+  // Paints `snapshot` instead of the scene until the view moves or settles.
+  // Ignored unless it shows exactly what the view currently shows.
+  bool showSnapshot(const QPixmap &snapshot, const QRectF &sceneRect);
+  // Goes back to painting the scene, e.g. once the content is replaced
+  void clearSnapshot();
+
+  // Ctrl+wheel zoom eases towards the requested zoom over a few frames
+  // instead of jumping to it
+  void setSmoothZoom(bool enable) { m_smoothZoom = enable; }
+
+  void setRenderMode(RenderMode mode);
+  RenderMode renderMode() const { return m_renderMode; }
+  // What the non-direct modes paint; must match the scene content
+  void setRenderSource(std::shared_ptr<RenderSource> source);
+
 signals:
   void mouseMoved();
+  // Time spent rendering the frame just shown. In threaded mode it is the
+  // worker's render time, emitted once per worker frame.
+  void frameRendered(qint64 nsecs);
+  void renderQualityChanged(CustomGraphicsView::RenderQuality quality);
+  // A Ctrl+wheel zoom gesture settled after `wheelEvents` events that
+  // took `repaints` frames to show
+  void zoomGestureFinished(int wheelEvents, int repaints);
 
 protected:
+  void paintEvent(QPaintEvent *event) override;
   void wheelEvent(QWheelEvent *event) override;
   void mouseMoveEvent(QMouseEvent *event) override;
   void resizeEvent(QResizeEvent *event) override;
 
 private:
   void setupGraphicsView();
-  void zoomView(double factor);
+  void zoomAround(qreal zoom, const QPointF &anchor);
+  void applyQueuedZoom();
+  void applyPendingResize();
+  int frameInterval() const;
+  void paintParallel(QPaintEvent *event);
+  // True when it shows a worker frame for the first time; that frame's
+  // render time goes to `renderNsecs`
+  bool paintThreaded(QPaintEvent *event, qint64 &renderNsecs);
+  QRectF visibleSceneRect() const;
+  QColor backgroundColor() const;
   void updateScaling();
+  qreal fitZoom(const QSize &viewSize) const;
+  void setRenderQuality(RenderQuality quality);
 
   double m_currentZoom;
   const double m_minZoom = 0.05;
@@ -37,6 +97,32 @@ private:
   QSize m_originalImageSize;
   QSize m_currentViewSize;
   QTransform m_currentTransform; // New member to store the current transform
+  RenderQuality m_renderQuality;
+  QTimer m_settleTimer;
+  QPixmap m_snapshot;
+
+  // Wheel zoom is accumulated and applied once per frame
+  QTimer m_zoomTimer;
+  qreal m_queuedZoomSteps;
+  QPointF m_zoomAnchor; // Viewport position kept fixed while zooming
+  bool m_smoothZoom;
+  qreal m_targetZoom;
+  int m_gestureWheelEvents;
+  int m_gestureRepaints;
+
+  // A burst of resize events is applied once per frame, relative to the
+  // view state from before the burst, unless setViewState() is called first
+  QTimer m_resizeTimer;
+  QSize m_resizeFromSize;
+  QPointF m_resizeCenter;
+  qreal m_resizeZoom;
+
+  RenderMode m_renderMode;
+  std::shared_ptr<RenderSource> m_renderSource;
+  RenderThread *m_renderThread;
+  RenderThread::Request m_lastRequest;
+  quint64 m_lastShownFrame;
+  QImage m_parallelFrame;
 };
 
 #endif // CUSTOM_GRAPHICS_VIEW_H
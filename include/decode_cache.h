@@ -0,0 +1,55 @@
+#ifndef DECODE_CACHE_H
+#define DECODE_CACHE_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+
+// Decoded images kept on disk between runs, so reopening a file skips the
+// decode. Each entry is one file holding a small header, the colour table
+// and the scanlines exactly as QImage lays them out in memory; a hit maps
+// the file and wraps the mapping in a QImage without copying any pixels.
+// Entries are keyed by the source file's path, size and modification time
+// plus a hash of its first bytes. Hits refresh an entry's timestamp, and
+// the least recently used entries are deleted once the directory exceeds
+// its limit.
+class DecodeCache {
+public:
+  DecodeCache(const QString &directory, qint64 maxBytes);
+
+  // Shared cache under the Neat data directory, sized by the
+  // decode_cache_mb setting
+  static DecodeCache &instance();
+
+  // Reads only the start of the file, so a lookup costs the same for any
+  // file size. Empty if the file cannot be read.
+  static QByteArray keyFor(const QString &filePath);
+
+  bool isEnabled() const { return m_maxBytes > 0; }
+
+  // The cached image for `key`, backed by a read-only mapping of the
+  // entry, or a null image if there is no valid entry. Safe to call from
+  // any thread.
+  QImage find(const QByteArray &key);
+  // Writes `image` for `key`, replacing the entry atomically, then evicts
+  // old entries. Safe to call from any thread.
+  bool insert(const QByteArray &key, const QImage &image);
+  // insert() on a low-priority writer thread, so a load never waits for
+  // the disk. The image shares its pixels until the write is done.
+  void insertLater(const QByteArray &key, const QImage &image);
+  // Blocks until every insertLater() so far has been written
+  void waitForWrites() { m_writer.waitForDone(); }
+
+private:
+  QString entryPath(const QByteArray &key) const;
+  void evict();
+
+  QString m_directory;
+  qint64 m_maxBytes;
+  QMutex m_evictMutex;
+  QThreadPool m_writer;
+};
+
+#endif // DECODE_CACHE_H
@@ -0,0 +1,18 @@
+#ifndef IMAGE_COMPACTION_H
+#define IMAGE_COMPACTION_H
+
+#include <QImage>
+
+// Scans a decoded image once and, when it can be stored losslessly in a
+// smaller pixel format, returns it converted to that format:
+//   - Format_Mono for images with at most two distinct colours (1 bpp)
+//   - Format_Grayscale8 for opaque images where r == g == b (8 bpp)
+//   - Format_Indexed8 for images with at most 256 colours (8 bpp)
+// Anything else, and images already in a compact format, are returned
+// unchanged.
+QImage compactImage(QImage image);
+
+// True for the formats compactImage() produces.
+bool isCompactFormat(QImage::Format format);
+
+#endif // IMAGE_COMPACTION_H
@@ -0,0 +1,99 @@
+#ifndef IMAGE_DECODER_H
+#define IMAGE_DECODER_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QRect>
+#include <QSize>
+#include <QString>
+#include <memory>
+
+class QBuffer;
+class QImageReader;
+
+// Source of decoded pixels for a raster image. Backends report which parts
+// of a decode they can do natively, so callers can ask for only the region
+// and resolution they are about to draw.
+class ImageDecoder {
+public:
+  enum Capability {
+    NoCapabilities = 0x0,
+    RegionDecode = 0x1, // Can decode a sub-rectangle without the full image
+    ScaledDecode = 0x2, // Can downscale while decoding (e.g. JPEG DCT scaling)
+  };
+
+  virtual ~ImageDecoder() = default;
+
+  virtual bool canRead() const = 0;
+  virtual QSize size() const = 0;
+  virtual QString format() const = 0;
+  virtual int capabilities() const = 0;
+
+  // Decodes `region` (full-resolution pixels, null for the whole image) into
+  // an image of `scaledSize` (invalid for no scaling). Returns a null image
+  // on failure.
+  virtual QImage read(const QRect &region = QRect(),
+                      const QSize &scaledSize = QSize()) const = 0;
+
+  // The original encoded bytes, used when saving a presentation.
+  virtual QByteArray encodedData() const = 0;
+
+  bool supports(Capability capability) const {
+    return (capabilities() & capability) != 0;
+  }
+
+  static std::shared_ptr<ImageDecoder> fromFile(const QString &filePath);
+  static std::shared_ptr<ImageDecoder> fromData(QByteArray data,
+                                                const QString &format);
+  static std::shared_ptr<ImageDecoder> fromImage(QImage image,
+                                                 const QString &format);
+};
+
+// Backend built on QImageReader. Region and scaled decoding are reported as
+// native only when the format's image handler implements them; otherwise
+// QImageReader still honours the request, but after a full decode.
+class QtImageDecoder : public ImageDecoder {
+public:
+  explicit QtImageDecoder(const QString &filePath);
+  QtImageDecoder(QByteArray data, const QString &format);
+
+  bool canRead() const override { return m_canRead; }
+  QSize size() const override { return m_size; }
+  QString format() const override { return m_format; }
+  int capabilities() const override { return m_capabilities; }
+  QImage read(const QRect &region = QRect(),
+              const QSize &scaledSize = QSize()) const override;
+  QByteArray encodedData() const override;
+
+private:
+  void probe();
+  void setupReader(QImageReader &reader, QBuffer &buffer) const;
+
+  QString m_filePath;
+  QByteArray m_data;
+  QString m_format;
+  QSize m_size;
+  int m_capabilities;
+  bool m_canRead;
+};
+
+// Backend over an image that is already decoded in memory, typically kept
+// in a compact pixel format. Regions are cut and scaled from it on demand.
+class MemoryImageDecoder : public ImageDecoder {
+public:
+  MemoryImageDecoder(QImage image, const QString &format);
+
+  bool canRead() const override { return !m_image.isNull(); }
+  QSize size() const override { return m_image.size(); }
+  QString format() const override { return m_format; }
+  int capabilities() const override { return RegionDecode | ScaledDecode; }
+  QImage read(const QRect &region = QRect(),
+              const QSize &scaledSize = QSize()) const override;
+  QByteArray encodedData() const override;
+
+private:
+  QImage m_image;
+  QString m_format;
+};
+
+#endif // IMAGE_DECODER_H
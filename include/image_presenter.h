@@ -1,26 +1,56 @@
 #ifndef IMAGE_PRESENTER_H
 #define IMAGE_PRESENTER_H
 
+#include "content_loader.h"
 #include "custom_graphics_view.h"
+#include "navigation_animator.h"
+#include "recent_preloader.h"
+#include "render_policy.h"
+#include "snapshot_cache.h"
+#include "tiled_image_item.h"
 #include <QComboBox>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
 #include <QGraphicsScene>
+#include <QGraphicsSimpleTextItem>
 #include <QGraphicsSvgItem>
 #include <QHBoxLayout>
 #include <QLabel>
 #include <QMainWindow>
-#include <QPropertyAnimation>
 #include <QPushButton>
 #include <QStatusBar>
+#include <QSvgRenderer>
 #include <QTimer>
 #include <QVBoxLayout>
+#include <memory>
 #include <tuple>
 #include <vector>
 
+// Startup choices made on the command line
+struct PresenterOptions {
+  CustomGraphicsView::RenderMode renderMode =
+      CustomGraphicsView::RenderMode::Direct;
+  // Reopen the last file after the window first paints
+  bool restoreLastFile = true;
+  // Opened instead of the last file when set
+  QString initialFile;
+};
+
 class ImagePresenter : public QMainWindow {
   Q_OBJECT
 
 public:
-  ImagePresenter();
+  explicit ImagePresenter(const PresenterOptions &options = PresenterOptions());
+  // Loads on the calling thread; used by the load benchmark
+  void loadFile(const QString &filePath);
+  // Decodes on a worker thread and shows a placeholder meanwhile
+  void loadFileAsync(const QString &filePath);
+  // Opens a file another launch forwarded and brings the window forward
+  void openForwardedFile(const QString &filePath);
+
+signals:
+  // The first frame is painted and the last file, if any, is restored
+  void startupComplete();
 
 private slots:
   void loadImage();
@@ -37,26 +67,44 @@ private:
   void setupVariables();
   void setupConnections();
   void loadLastState();
+  void restoreLastFile();
+  void finishStartup();
   void updateWindowTitle();
   void updateRecentFilesDropdown();
   void addToRecentFiles(const QString &filePath);
+  void positionTopBar();
+  void positionDiagnostics();
+  void toggleDiagnostics();
   void startHideTimer();
   void hideTopBarAndCursor();
   void showTopBarAndCursor();
   void onMouseMove();
   void toggleHiding(bool enable);
-  void loadFile(const QString &filePath);
-  void loadImageFile(const QString &filePath);
-  void loadSvgFile(const QString &filePath);
-  void loadPresentation(const QString &filePath);
+  void clearContent();
+  // Shows the result of `future` unless another file is opened first;
+  // `preloaded` marks a future taken over from the preloader
+  void watchLoad(const QString &filePath,
+                 const QFuture<LoadedContent> &future, bool preloaded);
+  void showContent(LoadedContent content);
   QByteArray encodeImageData();
+  bool hasContent() const;
+  void updateRenderSource();
+  void updateRenderPolicy();
   void updateStatusBar();
   void navigateToPoint(const std::tuple<QPointF, qreal> &point);
   void smoothNavigateToPoint(const QPointF &startCenter,
                              const QPointF &endCenter, qreal startZoom,
                              qreal endZoom);
   void navigateToNextPoint(int direction);
-  QString transformNestedSvg(const QString &svgContent);
+  void onNavigationFinished(const NavigationAnimator::FrameStats &stats);
+  void schedulePrefetch();
+  void idleStep();
+  void resumeIdleWork();
+  std::vector<int> snapshotOrder() const;
+  bool startNextSnapshot();
+  void finishSnapshot();
+
+  PresenterOptions options;
 
   QWidget *centralWidget;
   QVBoxLayout *layout;
@@ -68,13 +116,27 @@ private:
   QPushButton *fullscreenButton; // New button for fullscreen toggle
   QComboBox *recentFilesDropdown;
   QLabel *instructionsLabel;
+  QLabel *diagnosticsLabel;
   CustomGraphicsView *graphicsView;
   QGraphicsScene *scene;
   QStatusBar *statusBar;
 
   QGraphicsPixmapItem *imageItem;
+  TiledImageItem *tiledItem;
   QGraphicsSvgItem *svgItem;
   QString svgContent; // Added to store the original SVG content
+  std::shared_ptr<QSvgRenderer> svgRenderer;
+  // The content for painting off the GUI thread
+  std::shared_ptr<RenderSource> renderSource;
+  QGraphicsSimpleTextItem *placeholderItem;
+  int loadGeneration;
+  int pendingLoads; // Background loads started by loadFileAsync()
+  QElapsedTimer loadTimer;
+  QString restoreFilePath; // Opened once the first frame is painted
+  int restoreGeneration;
+  bool restorePending;
+  bool firstFramePainted;
+  bool startupFinished;
 
   std::vector<std::tuple<QPointF, qreal>> presentationPoints;
   int currentPointIndex;
@@ -83,12 +145,30 @@ private:
   QStringList recentFiles;
   QString currentFilePath;
 
-  QPropertyAnimation *animation;
+  NavigationAnimator *navigator;
+  RenderPolicy *renderPolicy;
   QTimer *hideTimer;
+  QElapsedTimer lastMouseMove;
+  QTimer *idleTimer;
+  QFutureWatcher<void> *prefetchWatcher;
+  RecentPreloader *preloader;
+  std::unique_ptr<SnapshotCache> snapshots;
+
+  // The snapshot being rendered on the thread pool
+  struct SnapshotJob {
+    int index = -1;
+    QRectF sceneRect;
+    QSize viewportSize;
+    qreal devicePixelRatio = 1.0;
+    int loadGeneration = -1;
+  };
+  SnapshotJob snapshotJob;
+  QFutureWatcher<QImage> *snapshotWatcher;
 
 protected:
   void keyPressEvent(QKeyEvent *event) override;
   void mouseMoveEvent(QMouseEvent *event) override;
+  void resizeEvent(QResizeEvent *event) override;
 };
 
 #endif // IMAGE_PRESENTER_H
@@ -0,0 +1,36 @@
+#ifndef INSTANCE_SERVER_H
+#define INSTANCE_SERVER_H
+
+#include <QObject>
+#include <QString>
+
+class QLocalServer;
+
+// Local socket through which a running Neat opens files for later launches.
+// Every connection carries one or more absolute file paths, one per line,
+// so opening a file from the file manager reuses the existing window
+// instead of starting Qt and restoring the last file all over again.
+class InstanceServer : public QObject {
+  Q_OBJECT
+
+public:
+  explicit InstanceServer(QObject *parent = nullptr);
+
+  // Starts accepting forwarded files. A socket left behind by a crashed
+  // instance is replaced; a live one is left alone and false is returned.
+  bool listen();
+
+  // Hands `filePath` to a running instance. Returns false if none is
+  // listening. Needs a QCoreApplication, not a full QApplication.
+  static bool forward(const QString &filePath);
+
+signals:
+  void fileRequested(const QString &filePath);
+
+private:
+  void acceptConnection();
+
+  QLocalServer *m_server;
+};
+
+#endif // INSTANCE_SERVER_H
@@ -0,0 +1,85 @@
+#ifndef NAVIGATION_ANIMATOR_H
+#define NAVIGATION_ANIMATOR_H
+
+#include <QEasingCurve>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QPointF>
+#include <QTimer>
+
+class CustomGraphicsView;
+
+// Drives a smooth pan/zoom between two view states. Each step waits until
+// the view has painted the previous one, then runs at the next refresh
+// interval of the screen showing the view, counted from the start of the
+// animation so the steps do not drift. The progress of each step comes
+// from the elapsed time, so a slow frame makes the animation skip ahead
+// instead of falling behind. Every run records frame statistics.
+//
+// The view's raster painting gives no feedback on when a frame reaches the
+// screen, so the intervals follow the screen's nominal refresh rate rather
+// than its vblank, and the statistics count painted frames: the closest
+// the view can tell to presented ones.
+class NavigationAnimator : public QObject {
+  Q_OBJECT
+
+public:
+  struct FrameStats {
+    int frames = 0;       // Painted while the animation ran
+    int missedFrames = 0; // Refresh intervals that got no painted frame
+    qreal refreshRate = 0.0;
+    qreal durationMs = 0.0;
+    qreal averageIntervalMs = 0.0;
+    qreal maxIntervalMs = 0.0;
+    qreal averageRenderMs = 0.0;
+    qreal maxRenderMs = 0.0;
+
+    // True when no frame was missed and every render fit in a refresh
+    bool heldRefreshRate() const;
+    QString summary() const;
+  };
+
+  explicit NavigationAnimator(CustomGraphicsView *view,
+                              QObject *parent = nullptr);
+
+  void setDuration(int msecs) { m_duration = msecs; }
+  void setEasingCurve(const QEasingCurve &curve) { m_easing = curve; }
+
+  void start(const QPointF &startCenter, qreal startZoom,
+             const QPointF &endCenter, qreal endZoom);
+  void stop();
+  bool isRunning() const { return m_running; }
+  const FrameStats &lastStats() const { return m_stats; }
+
+signals:
+  void finished(const NavigationAnimator::FrameStats &stats);
+
+private slots:
+  void step();
+  void recordRender(qint64 nsecs);
+
+private:
+  void apply(qreal progress);
+  void scheduleStep();
+  void finish();
+
+  CustomGraphicsView *m_view;
+  QTimer m_timer;
+  QElapsedTimer m_clock;
+  QEasingCurve m_easing;
+  int m_duration;
+
+  QPointF m_startCenter;
+  QPointF m_endCenter;
+  qreal m_startZoom;
+  qreal m_endZoom;
+
+  bool m_running;
+  bool m_awaitingFrame; // A step was applied and its frame not painted yet
+  qreal m_frameIntervalMs;
+  qint64 m_lastFrameNsecs;
+  qreal m_renderTotalMs;
+  FrameStats m_stats;
+};
+
+#endif // NAVIGATION_ANIMATOR_H
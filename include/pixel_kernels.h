@@ -0,0 +1,48 @@
+#ifndef PIXEL_KERNELS_H
+#define PIXEL_KERNELS_H
+
+#include <cstdint>
+
+// Pixel conversion and downscaling kernels for the raster path. Each kernel
+// has a scalar reference implementation plus SSE2 and AVX2 variants on x86;
+// the fastest one supported by the running CPU is picked on first use. All
+// variants produce bit-identical results.
+//
+// 32-bit pixels use QImage's in-register layout (0xAARRGGBB), 24-bit pixels
+// QImage::Format_RGB888's byte order (R, G, B). Strides are in bytes.
+namespace pixel_kernels {
+
+// In increasing order, which NEAT_PIXEL_ISA relies on
+enum class Isa { Scalar, SSE2, AVX2 };
+
+// The instruction set the dispatched kernels use
+Isa activeIsa();
+const char *isaName(Isa isa);
+
+// RGB888 -> RGB32/ARGB32 (alpha set to 0xff). `src` and `dst` must not
+// overlap.
+void rgb888ToArgb32(const std::uint8_t *src, std::uint32_t *dst, int count);
+
+// ARGB32 -> ARGB32_Premultiplied, rounding like qPremultiply(). `src` may
+// equal `dst`.
+void premultiplyArgb32(const std::uint32_t *src, std::uint32_t *dst,
+                       int count);
+
+// 2x2 box filter over 32-bit pixels, each channel rounded to nearest. The
+// destination is ceil(width / 2) x ceil(height / 2); odd edges repeat the
+// last row/column. Meant for premultiplied or opaque pixels.
+void downsample2xArgb32(const std::uint32_t *src, int srcStride, int width,
+                        int height, std::uint32_t *dst, int dstStride);
+
+// Reference implementations, always scalar
+namespace reference {
+void rgb888ToArgb32(const std::uint8_t *src, std::uint32_t *dst, int count);
+void premultiplyArgb32(const std::uint32_t *src, std::uint32_t *dst,
+                       int count);
+void downsample2xArgb32(const std::uint32_t *src, int srcStride, int width,
+                        int height, std::uint32_t *dst, int dstStride);
+} // namespace reference
+
+} // namespace pixel_kernels
+
+#endif // PIXEL_KERNELS_H
@@ -0,0 +1,25 @@
+#ifndef RASTER_CONVERSION_H
+#define RASTER_CONVERSION_H
+
+#include <QImage>
+#include <QSize>
+
+// QImage front end for pixel_kernels, used on the raster path between the
+// decoder and the scene.
+
+// Converts to the format the raster paint engine draws fastest: RGB32 for
+// opaque images, ARGB32_Premultiplied otherwise. ARGB32 is premultiplied in
+// place.
+QImage toDisplayFormat(QImage image);
+
+// Converts to straight (non-premultiplied) 32-bit pixels, RGB32 or ARGB32.
+QImage toStraight32(QImage image);
+
+// Halves an image in display format with a 2x2 box filter.
+QImage downsample2x(const QImage &image);
+
+// Returns true if `size` is `source` halved `levels` times (rounding up),
+// which is what downsample2x() produces.
+bool isHalvedSize(const QSize &source, const QSize &size, int &levels);
+
+#endif // RASTER_CONVERSION_H
@@ -0,0 +1,74 @@
+#ifndef RECENT_PRELOADER_H
+#define RECENT_PRELOADER_H
+
+#include "content_loader.h"
+#include <QDateTime>
+#include <QFutureWatcher>
+#include <QObject>
+#include <QSet>
+#include <QSize>
+#include <QStringList>
+#include <map>
+
+// Keeps recently opened files decoded, so switching to one from the recent
+// files list skips the load. Files are decoded one at a time on the thread
+// pool, most likely first, until the memory budget is used up. Tiled
+// images also get the tiles of their initial, fitted view decoded there.
+class RecentPreloader : public QObject {
+  Q_OBJECT
+
+public:
+  explicit RecentPreloader(QObject *parent = nullptr);
+
+  void setBudget(qint64 bytes);
+  // Used to pick the tiles of the fitted view
+  void setViewport(const QSize &size, qreal devicePixelRatio);
+
+  // Files worth keeping, most likely first; the rest are dropped
+  void setCandidates(const QStringList &filePaths);
+
+  // Starts the next background preload, unless one is running or there is
+  // nothing left to preload; loadFinished() follows
+  void preloadNext();
+
+  // Hands over the preloaded content for `filePath`, if it is still
+  // current, and forgets it
+  bool take(const QString &filePath, LoadedContent &content);
+  // The running preload, if it is of the current `filePath`; its result
+  // then goes to the caller only. Invalid otherwise.
+  QFuture<LoadedContent> adopt(const QString &filePath);
+  // Asks the running preload to stop, so it does not compete with a load
+  // of the user's; it is retried when idle again
+  void cancel();
+
+  qint64 usedBytes() const { return m_usedBytes; }
+
+signals:
+  // A background preload finished, so preloadNext() has work again
+  void loadFinished();
+
+private:
+  struct Entry {
+    LoadedContent content;
+    QDateTime modified;
+    qint64 cost;
+  };
+
+  void finishLoad();
+  qint64 costOf(const LoadedContent &content) const;
+
+  qint64 m_budget;
+  qint64 m_usedBytes;
+  QSize m_viewportSize;
+  qreal m_devicePixelRatio;
+  QStringList m_candidates;
+  std::map<QString, Entry> m_ready;
+  // Failed or too large for the budget; not retried this session
+  QSet<QString> m_rejected;
+  QString m_loading;
+  QDateTime m_loadingModified;
+  bool m_adopted; // The running preload's result belongs to a user load
+  QFutureWatcher<LoadedContent> m_watcher;
+};
+
+#endif // RECENT_PRELOADER_H
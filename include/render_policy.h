@@ -0,0 +1,60 @@
+#ifndef RENDER_POLICY_H
+#define RENDER_POLICY_H
+
+#include <QGraphicsItem>
+#include <QGraphicsView>
+#include <QObject>
+#include <QString>
+#include <vector>
+
+class CustomGraphicsView;
+
+// Chooses the item cache mode, the view's background cache and the viewport
+// update mode for the loaded content. A starting policy comes from the
+// content type; once the first full-quality frames are past, the median
+// paint cost of the next ones decides whether caching the item is worth its
+// memory.
+class RenderPolicy : public QObject {
+  Q_OBJECT
+
+public:
+  enum class Content { None, Raster, TiledRaster, Vector };
+
+  struct Decision {
+    Content content = Content::None;
+    QGraphicsItem::CacheMode cacheMode = QGraphicsItem::NoCache;
+    QSize cacheSize; // Only used by ItemCoordinateCache
+    QGraphicsView::ViewportUpdateMode updateMode =
+        QGraphicsView::MinimalViewportUpdate;
+    QGraphicsView::CacheMode backgroundCache = QGraphicsView::CacheBackground;
+    qreal paintMs = -1.0; // Median of the sampled frames; negative until then
+    QString reason;
+
+    QString summary() const;
+  };
+
+  explicit RenderPolicy(CustomGraphicsView *view, QObject *parent = nullptr);
+
+  // Applies the starting policy for `item` and measures it from scratch.
+  // `item` may be null when nothing is loaded.
+  void setContent(QGraphicsItem *item, Content content);
+  const Decision &decision() const { return m_decision; }
+
+signals:
+  void decisionChanged(const RenderPolicy::Decision &decision);
+
+private slots:
+  void recordFrame(qint64 nsecs);
+
+private:
+  void decide();
+  void apply();
+
+  CustomGraphicsView *m_view;
+  QGraphicsItem *m_item;
+  Decision m_decision;
+  int m_skippedFrames;
+  std::vector<qint64> m_samples; // Paint times, in nanoseconds
+};
+
+#endif // RENDER_POLICY_H
@@ -0,0 +1,40 @@
+#ifndef RENDER_SOURCE_H
+#define RENDER_SOURCE_H
+
+#include <QByteArray>
+#include <QColor>
+#include <QImage>
+#include <QPainter>
+#include <QRectF>
+#include <memory>
+
+class TilePyramid;
+
+// The content of the scene in a form that can be painted without going
+// through QGraphicsScene, for renderers running off the GUI thread. paint()
+// must be safe to call from several threads at once.
+class RenderSource {
+public:
+  virtual ~RenderSource() = default;
+
+  // Paints the content inside `exposed` (scene coordinates); the painter's
+  // world transform maps scene to logical device coordinates
+  virtual void paint(QPainter *painter, const QRectF &exposed) = 0;
+
+  // `image` is only read, so it can share its data with a pixmap or item
+  static std::shared_ptr<RenderSource> fromImage(QImage image);
+  static std::shared_ptr<RenderSource>
+  fromPyramid(std::shared_ptr<TilePyramid> pyramid);
+  static std::shared_ptr<RenderSource> fromSvg(QByteArray content);
+};
+
+// Paints the `sceneRect` part of `source`, scaled to cover the whole of
+// `frame`, over `background`. Only `area` (logical frame coordinates) is
+// touched. With `bands` > 1 the area is split into horizontal bands that
+// are painted in parallel, each with its own QPainter on the shared pixels,
+// on a thread pool reserved for frame bands.
+void renderFrame(RenderSource &source, QImage &frame, const QRectF &sceneRect,
+                 const QRect &area, QPainter::RenderHints hints,
+                 const QColor &background, int bands = 1);
+
+#endif // RENDER_SOURCE_H
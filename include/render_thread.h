@@ -0,0 +1,59 @@
+#ifndef RENDER_THREAD_H
+#define RENDER_THREAD_H
+
+#include "render_source.h"
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+#include <optional>
+
+// Renders frames of a RenderSource on a worker thread. A new request
+// replaces any request the worker has not started yet, and the GUI thread
+// picks up the most recent finished frame with latestFrame(). Frames are
+// double-buffered: the worker paints into one image while the other is
+// being shown.
+class RenderThread : public QThread {
+  Q_OBJECT
+
+public:
+  struct Request {
+    std::shared_ptr<RenderSource> source;
+    QRectF sceneRect;
+    QSize size; // Logical size of the frame
+    qreal devicePixelRatio = 1.0;
+    QPainter::RenderHints hints;
+    QColor background;
+
+    bool operator==(const Request &other) const;
+  };
+
+  struct Frame {
+    QImage image;
+    QRectF sceneRect; // Scene area the image shows
+    qint64 renderNsecs = 0;
+    quint64 serial = 0; // Increases with every frame, 0 for none yet
+  };
+
+  explicit RenderThread(QObject *parent = nullptr);
+  ~RenderThread() override;
+
+  void request(const Request &request);
+  Frame latestFrame() const;
+
+signals:
+  // Emitted from the worker thread after each frame
+  void frameReady(qint64 nsecs);
+
+protected:
+  void run() override;
+
+private:
+  mutable QMutex m_mutex;
+  QWaitCondition m_wake;
+  std::optional<Request> m_pending;
+  bool m_quit;
+  Frame m_front;
+  QImage m_back;
+};
+
+#endif // RENDER_THREAD_H
@@ -0,0 +1,107 @@
+#ifndef SESSION_LOGGER_H
+#define SESSION_LOGGER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+enum class LogLevel { Debug, Info, Warning, Error };
+
+// One line of events.jsonl. Unset fields are left out of the line.
+struct SessionEvent {
+  std::string type; // load, load_error, navigation, save, startup
+  std::string file;
+  double ms = -1.0;
+  std::int64_t bytes = -1;
+  std::string error;
+  // Further numbers, e.g. frame statistics or image dimensions
+  std::vector<std::pair<const char *, double>> values;
+};
+
+// Writes log.txt and events.jsonl in the Neat data directory from a
+// background thread. log() and event() only timestamp their argument and
+// push it onto a lock-free list, so they can be called from any thread,
+// including hot GUI paths. The writer wakes up every few hundred
+// milliseconds, or once a batch has built up, formats everything pending
+// and writes each file with a single flush. Both files are rotated
+// (log.1.txt, events.1.jsonl, ...) once they grow past their size limit.
+class SessionLogger {
+public:
+  // Rotated files kept behind each current one
+  static constexpr int kRotatedFiles = 3;
+
+  // The process-wide logger; the minimum level comes from the log_level
+  // setting (debug, info, warning or error, default info)
+  static SessionLogger &instance();
+
+  SessionLogger(const std::string &directory, LogLevel minLevel);
+  ~SessionLogger(); // Writes what is still queued
+  SessionLogger(const SessionLogger &) = delete;
+  SessionLogger &operator=(const SessionLogger &) = delete;
+
+  bool isEnabled(LogLevel level) const { return level >= m_minLevel; }
+  void log(LogLevel level, std::string message);
+  // Events are written whatever the log level
+  void event(SessionEvent event);
+  // Blocks until everything logged so far is written
+  void flush();
+
+  // events.jsonl in `directory` for `index` 0, and its rotated
+  // predecessors, newest first, for 1 to kRotatedFiles
+  static std::string eventsPath(const std::string &directory, int index);
+
+private:
+  struct Entry {
+    Entry *next;
+    std::chrono::system_clock::time_point time;
+    LogLevel level;
+    std::string message;
+    bool isEvent;
+    SessionEvent event;
+  };
+
+  // A log file and its rotated predecessors, <name>.1<extension> onwards
+  struct Output {
+    std::string name;
+    std::string extension;
+    std::uint64_t maxBytes;
+    std::ofstream file;
+    std::uint64_t size = 0;
+  };
+
+  void push(Entry *entry);
+  void run();
+  // Writes the queued entries; returns false once there were none
+  bool writePending();
+  void open(Output &output);
+  void write(Output &output, const std::string &batch);
+  void rotate(Output &output);
+
+  const std::string m_directory;
+  const LogLevel m_minLevel;
+
+  std::atomic<Entry *> m_pending;
+  std::atomic<int> m_pendingCount;
+  std::atomic<std::uint64_t> m_logged;
+  std::atomic<std::uint64_t> m_written;
+
+  std::mutex m_wakeMutex;
+  std::condition_variable m_wake;
+  std::condition_variable m_drained;
+  bool m_stopping;
+  bool m_flushRequested;
+
+  // Writer thread only
+  Output m_log;
+  Output m_events;
+  std::thread m_thread;
+};
+
+#endif // SESSION_LOGGER_H
@@ -0,0 +1,14 @@
+#ifndef SESSION_STATS_H
+#define SESSION_STATS_H
+
+#include <ostream>
+#include <string>
+
+// `neat stats`: aggregates events.jsonl and its rotated predecessors in
+// `directory` and prints, per event type, counts and duration
+// percentiles, followed by the slowest files to load and the files that
+// failed. Lines are scanned for the few keys it needs instead of being
+// parsed as JSON, so millions of events take seconds at most.
+int runSessionStats(const std::string &directory, std::ostream &out);
+
+#endif // SESSION_STATS_H
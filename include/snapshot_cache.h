@@ -0,0 +1,63 @@
+#ifndef SNAPSHOT_CACHE_H
+#define SNAPSHOT_CACHE_H
+
+#include <QCache>
+#include <QHashFunctions>
+#include <QPixmap>
+#include <QRectF>
+#include <QSize>
+
+// Full-viewport renders of presentation points. Every snapshot belongs to
+// one viewport size and device pixel ratio, and only the snapshots of the
+// current viewport are visible. The others stay cached, so moving the
+// window back to a screen reuses them, until the least recently used
+// snapshots are evicted at the byte limit.
+class SnapshotCache {
+public:
+  struct Snapshot {
+    QPixmap pixmap;
+    QRectF sceneRect; // Scene area the pixmap shows
+  };
+
+  explicit SnapshotCache(qint64 maxBytes);
+
+  void setMaxBytes(qint64 bytes);
+  // Selects the viewport later calls refer to
+  void setViewport(const QSize &size, qreal devicePixelRatio);
+  void clear() { m_snapshots.clear(); }
+
+  bool contains(int index) const { return m_snapshots.contains(key(index)); }
+  const Snapshot *snapshot(int index) { return m_snapshots.object(key(index)); }
+  void insert(int index, const Snapshot &snapshot);
+
+  // True when one more snapshot of the current viewport fits without
+  // evicting another snapshot of the current viewport
+  bool hasRoomForAnother() const;
+
+private:
+  struct Key {
+    int index;
+    QSize size;
+    qreal devicePixelRatio;
+
+    bool operator==(const Key &other) const {
+      return index == other.index && size == other.size &&
+             devicePixelRatio == other.devicePixelRatio;
+    }
+    friend size_t qHash(const Key &key, size_t seed = 0) {
+      return qHashMulti(seed, key.index, key.size.width(), key.size.height(),
+                        key.devicePixelRatio);
+    }
+  };
+
+  Key key(int index) const {
+    return {index, m_viewportSize, m_devicePixelRatio};
+  }
+  qint64 viewportCost() const;
+
+  QCache<Key, Snapshot> m_snapshots; // Cost in KiB
+  QSize m_viewportSize;
+  qreal m_devicePixelRatio;
+};
+
+#endif // SNAPSHOT_CACHE_H
@@ -0,0 +1,22 @@
+#ifndef STARTUP_TRACE_H
+#define STARTUP_TRACE_H
+
+#include <QString>
+
+// Monotonic timestamps of the startup phases, measured from the top of
+// main(). Marks are always recorded, since they cost next to nothing;
+// --startup-trace prints them once the first frame is painted and the last
+// file is restored. GUI thread only.
+class StartupTrace {
+public:
+  static void start();
+  static void mark(const QString &phase);
+
+  // Milliseconds from start() to `phase`, or -1 if it was never marked
+  static qreal elapsedMs(const QString &phase);
+  // One line per phase with its time since start and since the previous
+  // phase
+  static QString report();
+};
+
+#endif // STARTUP_TRACE_H
@@ -0,0 +1,87 @@
+#ifndef STATE_STORE_H
+#define STATE_STORE_H
+
+#include "json.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A setting stored under "settings" in state.json. When `envVar` is set in
+// the environment it overrides the stored value for this run.
+template <typename T> struct Setting {
+  const char *key;
+  const char *envVar;
+  T defaultValue;
+};
+
+namespace settings {
+// Upper bound for decoded image memory; 0 leaves only the system limit
+inline const Setting<std::uint64_t> memoryBudgetMb{
+    "memory_budget_mb", "NEAT_MEMORY_BUDGET_MB", 0};
+// Size of the on-disk decode cache; 0 disables it
+inline const Setting<std::uint64_t> decodeCacheMb{
+    "decode_cache_mb", "NEAT_DECODE_CACHE_MB", 1024};
+// Recently opened files decoded ahead of time; also capped at a quarter of
+// the memory budget
+inline const Setting<std::uint64_t> preloadMb{"preload_mb", "NEAT_PRELOAD_MB",
+                                              512};
+inline const Setting<bool> smoothZoom{"smooth_zoom", "NEAT_SMOOTH_ZOOM",
+                                      false};
+inline const Setting<std::string> logLevel{"log_level", "NEAT_LOG_LEVEL",
+                                           "info"};
+} // namespace settings
+
+// In-memory copy of state.json. Reads never touch the disk. Writes update
+// the copy and mark the key dirty; a background thread saves once no
+// change has come in for a short while. Saving re-reads the file, applies
+// only the dirty keys on top and replaces the file atomically, so keys
+// this version does not know about, or that another instance changed, are
+// kept. Thread-safe.
+class StateStore {
+public:
+  // The store for state.json in the Neat data directory
+  static StateStore &instance();
+
+  explicit StateStore(const std::string &filePath);
+  ~StateStore(); // Saves pending changes
+  StateStore(const StateStore &) = delete;
+  StateStore &operator=(const StateStore &) = delete;
+
+  // `key` is a '/'-separated path, e.g. "settings/smooth_zoom". Missing
+  // keys and values of another type give `fallback`.
+  template <typename T>
+  T value(const std::string &key, const T &fallback) const;
+  template <typename T> void setValue(const std::string &key, const T &value);
+
+  template <typename T> T setting(const Setting<T> &setting) const;
+
+  // Blocks until pending changes are on disk
+  void flush();
+
+private:
+  static nlohmann::json readFile(const std::string &filePath);
+  void run();
+  // Called with m_mutex held; unlocks it while writing
+  void save(std::unique_lock<std::mutex> &lock);
+
+  const std::string m_filePath;
+
+  mutable std::mutex m_mutex;
+  nlohmann::json m_state;
+  std::set<std::string> m_dirty;
+  std::set<std::string> m_unsaved; // Dirty keys whose last save failed
+  std::chrono::steady_clock::time_point m_lastChange;
+  std::condition_variable m_changed;
+  std::condition_variable m_saved;
+  bool m_saving;
+  bool m_flushRequested;
+  bool m_stopping;
+  std::thread m_thread;
+};
+
+#endif // STATE_STORE_H
@@ -0,0 +1,87 @@
+#ifndef TILE_PYRAMID_H
+#define TILE_PYRAMID_H
+
+#include "image_decoder.h"
+#include <QCache>
+#include <QFuture>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QSet>
+#include <deque>
+#include <functional>
+#include <memory>
+
+class QPainter;
+
+// An ImageDecoder's image as a pyramid of fixed-size tiles (level n is
+// downscaled by 2^n). Tiles are decoded on demand and kept in an LRU cache;
+// a tile is only ever decoded by one thread at a time, and others needing
+// it meanwhile wait for that result.
+// paint() may run on several threads at once; the prefetch queue belongs to
+// the GUI thread, while the queued tiles are decoded on the thread pool.
+// Must be owned by a std::shared_ptr, which prefetch decodes hold on to.
+//
+// Painting without QPainter::SmoothPixmapTransform is treated as a draft
+// frame: the pyramid drops one level of detail and prefers any cached tile,
+// coarser ones included, over decoding.
+class TilePyramid : public std::enable_shared_from_this<TilePyramid> {
+public:
+  static constexpr int kTileSize = 512;
+
+  explicit TilePyramid(std::shared_ptr<ImageDecoder> decoder);
+
+  QSize size() const { return m_size; }
+  const ImageDecoder &decoder() const { return *m_decoder; }
+  void setCacheLimit(qint64 bytes);
+
+  // Paints the tiles covering `exposed` (in image coordinates) at the level
+  // matching the painter's world transform and device pixel ratio. Levels
+  // do not depend on the ratio, so moving between screens of different
+  // density picks other cached levels rather than invalidating any.
+  void paint(QPainter *painter, const QRectF &exposed);
+
+  // Queues the tiles that painting `region` at `scale` device pixels per
+  // image pixel would need and that are not cached yet. `draft` selects
+  // the level used for draft frames. Nothing is decoded until
+  // prefetchNext() is called, one tile per call, so the caller decides
+  // when there is idle time.
+  void prefetch(const QRectF &region, qreal scale, bool draft = false);
+  bool hasPendingPrefetch() const { return !m_prefetchQueue.empty(); }
+  // Takes the next queued tile and decodes it on the global thread pool;
+  // the future finishes once the tile is cached. Only call it while
+  // hasPendingPrefetch().
+  QFuture<void> prefetchNext();
+  // Decodes every queued tile on the calling thread, or until `stop`
+  // returns true; only for a pyramid that nothing else uses yet, e.g. one
+  // being built on a worker thread
+  void prefetchAll(const std::function<bool()> &stop = {});
+  void clearPrefetch();
+
+private:
+  struct TileId {
+    int level;
+    int x;
+    int y;
+  };
+
+  int levelForScale(qreal scale) const;
+  int levelForPaint(qreal scale, bool draft) const;
+  QRect tileRange(int level, const QRectF &region) const;
+  QRect tileSourceRect(int level, int tileX, int tileY) const;
+  QImage cachedTile(quint64 key) const;
+  QImage tile(int level, int tileX, int tileY);
+  QImage decodeTile(int level, int tileX, int tileY) const;
+  bool drawCachedTile(QPainter *painter, int level, int tileX, int tileY);
+
+  std::shared_ptr<ImageDecoder> m_decoder;
+  QSize m_size;
+  int m_maxLevel;
+  mutable QMutex m_tilesMutex;
+  mutable QCache<quint64, QImage> m_tiles; // Cost in KiB
+  QHash<quint64, QFuture<QImage>> m_decoding; // Tiles being decoded
+  std::deque<TileId> m_prefetchQueue;
+  QSet<quint64> m_prefetchQueued;
+};
+
+#endif // TILE_PYRAMID_H
@@ -0,0 +1,42 @@
+#ifndef TILED_IMAGE_ITEM_H
+#define TILED_IMAGE_ITEM_H
+
+#include "tile_pyramid.h"
+#include <QGraphicsItem>
+#include <memory>
+
+// Graphics item drawing a TilePyramid. Only the tiles intersecting the
+// exposed rect, at the level matching the current zoom, are decoded. Used
+// for images too large to keep fully decoded and for images held in a
+// compact pixel format.
+class TiledImageItem : public QGraphicsItem {
+public:
+  static constexpr int kTileSize = TilePyramid::kTileSize;
+
+  explicit TiledImageItem(std::shared_ptr<ImageDecoder> decoder,
+                          QGraphicsItem *parent = nullptr);
+  // Draws a pyramid whose tiles may already be partly decoded
+  explicit TiledImageItem(std::shared_ptr<TilePyramid> pyramid,
+                          QGraphicsItem *parent = nullptr);
+
+  QRectF boundingRect() const override;
+  void paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
+             QWidget *widget = nullptr) override;
+
+  const ImageDecoder &decoder() const { return m_pyramid->decoder(); }
+  void setCacheLimit(qint64 bytes) { m_pyramid->setCacheLimit(bytes); }
+  // Shared with renderers painting outside the scene
+  const std::shared_ptr<TilePyramid> &pyramid() const { return m_pyramid; }
+
+  void prefetch(const QRectF &region, qreal scale, bool draft = false) {
+    m_pyramid->prefetch(region, scale, draft);
+  }
+  bool hasPendingPrefetch() const { return m_pyramid->hasPendingPrefetch(); }
+  QFuture<void> prefetchNext() { return m_pyramid->prefetchNext(); }
+  void clearPrefetch() { m_pyramid->clearPrefetch(); }
+
+private:
+  std::shared_ptr<TilePyramid> m_pyramid;
+};
+
+#endif // TILED_IMAGE_ITEM_H
@@ -2,16 +2,30 @@
 #define UTILS_H
 
 #include <QStringList>
+#include <cstdint>
 #include <string>
 #include <vector>
 
+enum class LogLevel;
+struct SessionEvent;
+
 namespace utils {
 
 std::string ensure_neat_directory();
 void save_state(const std::string &file_path, const std::string &last_folder,
                 const std::vector<std::string> &recent_files);
 std::tuple<std::string, std::string, std::vector<std::string>> load_state();
+// Queued for the background session logger; cheap enough for hot paths
 void log_session(const std::string &message);
+void log_session(LogLevel level, const std::string &message);
+// Appended to events.jsonl by the same background writer
+void log_event(SessionEvent event);
+std::uint64_t available_memory_bytes();
+std::uint64_t image_memory_budget_bytes();
+std::uint64_t decode_cache_max_bytes();
+std::uint64_t current_rss_bytes();
+std::uint64_t peak_rss_bytes();
+void reset_peak_rss();
 QStringList stdVectorToQStringList(const std::vector<std::string> &vec);
 std::vector<std::string> QStringListToStdVector(const QStringList &list);
 } // namespace utils
@@ -0,0 +1,279 @@
+#include "content_loader.h"
+#include "decode_cache.h"
+#include "image_compaction.h"
+#include "raster_conversion.h"
+#include "utils.h"
+#include <QCoreApplication>
+#include <QDomDocument>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSvgRenderer>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+// Images with a side longer than this are shown through TiledImageItem when
+// their decoder can decode regions, instead of being decoded in full
+constexpr int kTilingThreshold = 4096;
+
+// Decoded tiles of a TiledImageItem never take more than this
+constexpr qint64 kMaxTileCacheBytes = qint64(256) << 20;
+
+// Tile budget for images kept in a compact format, so the expanded tiles do
+// not undo the savings; enough for a 4K viewport
+constexpr qint64 kCompactTileCacheBytes = qint64(64) << 20;
+
+QString transformNestedSvg(const QString &svgContent) {
+  QDomDocument doc;
+  if (!doc.setContent(svgContent)) {
+    return svgContent; // Return original if parsing fails
+  }
+
+  QDomElement root = doc.documentElement();
+  if (root.tagName().toLower() != "svg") {
+    return svgContent;
+  }
+
+  // Find all svg elements
+  QDomNodeList svgNodes = root.elementsByTagName("svg");
+
+  // If we have exactly 2 SVG elements (root + one nested)
+  if (svgNodes.length() == 1) {
+    // The second node is our nested svg
+    QDomElement nestedSvg = svgNodes.at(0).toElement();
+
+    // Create new g element
+    QDomElement gElement = doc.createElement("g");
+
+    // Copy all attributes from svg to g
+    QDomNamedNodeMap attrs = nestedSvg.attributes();
+    for (int i = 0; i < attrs.length(); i++) {
+      QDomAttr attr = attrs.item(i).toAttr();
+      gElement.setAttribute(attr.name(), attr.value());
+    }
+
+    // Move all children from nested svg to g
+    while (!nestedSvg.firstChild().isNull()) {
+      gElement.appendChild(nestedSvg.firstChild());
+    }
+
+    // Replace nested svg with g
+    nestedSvg.parentNode().replaceChild(gElement, nestedSvg);
+
+    return doc.toString();
+  }
+
+  return svgContent;
+}
+
+// Thrown before decoding when a load with a byte cap would go over it
+std::runtime_error overCap(const LoadedContent &content, qint64 bytes,
+                           qint64 maxDecodedBytes) {
+  return std::runtime_error(
+      QString("%1 needs %2 MB, more than the %3 MB allowed")
+          .arg(content.filePath)
+          .arg(bytes >> 20)
+          .arg(maxDecodedBytes >> 20)
+          .toStdString());
+}
+
+bool loadRaster(LoadedContent &content, std::shared_ptr<ImageDecoder> decoder,
+                qint64 maxDecodedBytes) {
+  const QSize size = decoder->size();
+  const qint64 budget = static_cast<qint64>(std::min<std::uint64_t>(
+      utils::image_memory_budget_bytes(), std::numeric_limits<qint64>::max()));
+
+  // Check the header dimensions before anything is allocated. A full decode
+  // needs 4 bytes per pixel; unknown sizes are left to QImageReader's
+  // allocation limit, set once by the presenter.
+  const qint64 decodedBytes =
+      size.isValid() ? static_cast<qint64>(size.width()) * size.height() * 4
+                     : 0;
+  const bool fitsInBudget = decodedBytes <= budget;
+  const bool canTile =
+      decoder->supports(ImageDecoder::RegionDecode) && size.isValid();
+  const bool tiled =
+      canTile && (!fitsInBudget ||
+                  qMax(size.width(), size.height()) > kTilingThreshold);
+
+  if (!tiled && !fitsInBudget) {
+    throw std::runtime_error(
+        QString("Image is too large to open: %1x%2 needs %3 MB, memory "
+                "budget is %4 MB")
+            .arg(size.width())
+            .arg(size.height())
+            .arg(decodedBytes >> 20)
+            .arg(budget >> 20)
+            .toStdString());
+  }
+
+  if (!tiled && maxDecodedBytes > 0 && decodedBytes > maxDecodedBytes) {
+    throw overCap(content, decodedBytes, maxDecodedBytes);
+  }
+
+  content.imageFormat = decoder->format();
+  if (tiled) {
+    // Tiles and pyramid levels are decoded on demand while painting, and
+    // the decoded tiles share the budget with everything else
+    content.kind = LoadedContent::Kind::Tiled;
+    content.decoder = std::move(decoder);
+    content.tileCacheBytes = qMin(budget / 4, kMaxTileCacheBytes);
+    return true;
+  }
+
+  // Small image, or no native region support: one full decode, unless an
+  // earlier run left its result in the decode cache
+  DecodeCache &cache = DecodeCache::instance();
+  QByteArray cacheKey;
+  QImage image;
+  if (cache.isEnabled()) {
+    cacheKey = DecodeCache::keyFor(content.filePath);
+    if (!cacheKey.isEmpty()) {
+      image = cache.find(cacheKey);
+    }
+  }
+  const bool cached = !image.isNull();
+  if (!cached) {
+    image = decoder->read();
+    if (image.isNull()) {
+      return false;
+    }
+  }
+  // Release the encoded bytes before anything else is allocated
+  decoder.reset();
+
+  if (!cached) {
+    // Flat-colour and grayscale images stay in their compact format; the
+    // rest is converted in place, so the GUI thread can hand the buffer to
+    // a pixmap without another copy
+    image = compactImage(std::move(image));
+    if (!isCompactFormat(image.format())) {
+      image = toDisplayFormat(std::move(image));
+    }
+    if (!cacheKey.isEmpty()) {
+      // Written in the background; the load does not wait for the disk
+      cache.insertLater(cacheKey, image);
+    }
+  }
+
+  content.decodedBytes = image.sizeInBytes();
+  if (isCompactFormat(image.format())) {
+    // Only the visible tiles are expanded to 32 bits for drawing
+    content.kind = LoadedContent::Kind::Tiled;
+    content.decoder =
+        ImageDecoder::fromImage(std::move(image), content.imageFormat);
+    content.tileCacheBytes = kCompactTileCacheBytes;
+  } else {
+    content.kind = LoadedContent::Kind::Raster;
+    content.image = std::move(image);
+  }
+  return true;
+}
+
+void loadSvg(LoadedContent &content, const QString &svgContent,
+             qint64 maxDecodedBytes) {
+  // The source text and the parsed document, roughly
+  const qint64 decodedBytes = qint64(svgContent.size()) * 4;
+  if (maxDecodedBytes > 0 && decodedBytes > maxDecodedBytes) {
+    throw overCap(content, decodedBytes, maxDecodedBytes);
+  }
+
+  // Transform nested SVG if needed
+  content.svgContent = transformNestedSvg(svgContent);
+
+  auto renderer = std::make_shared<QSvgRenderer>(content.svgContent.toUtf8());
+  if (!renderer->isValid()) {
+    throw std::runtime_error("Failed to load SVG file: " +
+                             content.filePath.toStdString());
+  }
+  // Parsed here, used by the scene item on the GUI thread
+  renderer->moveToThread(QCoreApplication::instance()->thread());
+
+  content.kind = LoadedContent::Kind::Svg;
+  content.imageFormat = "svg";
+  content.decodedBytes = decodedBytes;
+  content.svgRenderer = std::move(renderer);
+}
+
+void loadPresentation(LoadedContent &content, qint64 maxDecodedBytes) {
+  QFile file(content.filePath);
+  if (!file.open(QIODevice::ReadOnly)) {
+    throw std::runtime_error("Failed to open presentation file: " +
+                             content.filePath.toStdString());
+  }
+
+  // The encoded file is dropped as soon as it is parsed, and the base64
+  // payload is taken out of the JSON object and decoded in place, so only
+  // one copy of the image bytes is alive when decoding starts
+  QJsonObject data = QJsonDocument::fromJson(file.readAll()).object();
+  file.close();
+
+  bool isSvg = data["is_svg"].toBool();
+  QByteArray base64 = data.take("image_data").toString().toLatin1();
+  QByteArray imageData =
+      QByteArray::fromBase64Encoding(std::move(base64)).decoded;
+  const QString imageFormat = data["image_format"].toString();
+  content.imageFormat = imageFormat;
+
+  if (isSvg) {
+    loadSvg(content, QString::fromUtf8(imageData), maxDecodedBytes);
+  } else {
+    std::shared_ptr<ImageDecoder> decoder =
+        ImageDecoder::fromData(std::move(imageData), imageFormat);
+    if (!decoder->canRead() ||
+        !loadRaster(content, std::move(decoder), maxDecodedBytes)) {
+      throw std::runtime_error(
+          "Failed to load image data from presentation file");
+    }
+  }
+
+  QJsonArray points = data["presentation_points"].toArray();
+  for (const auto &pointJson : points) {
+    QJsonObject pointObj = pointJson.toObject();
+    QPointF point(pointObj["x"].toDouble(), pointObj["y"].toDouble());
+    qreal zoom = pointObj["zoom"].toDouble();
+    content.points.emplace_back(point, zoom);
+  }
+}
+
+} // namespace
+
+LoadedContent loadContent(const QString &filePath, qint64 maxDecodedBytes) {
+  QElapsedTimer timer;
+  timer.start();
+  LoadedContent content;
+  content.filePath = filePath;
+  try {
+    if (filePath.toLower().endsWith(".neatp")) {
+      loadPresentation(content, maxDecodedBytes);
+    } else if (filePath.toLower().endsWith(".svg")) {
+      QFile file(filePath);
+      if (!file.open(QIODevice::ReadOnly)) {
+        throw std::runtime_error("Failed to open SVG file: " +
+                                 filePath.toStdString());
+      }
+      loadSvg(content, QString::fromUtf8(file.readAll()), maxDecodedBytes);
+    } else {
+      std::shared_ptr<ImageDecoder> decoder = ImageDecoder::fromFile(filePath);
+      if (!decoder->canRead() ||
+          !loadRaster(content, std::move(decoder), maxDecodedBytes)) {
+        throw std::runtime_error("Failed to load image: " +
+                                 filePath.toStdString());
+      }
+    }
+  } catch (const std::exception &e) {
+    // Errors cross threads as data rather than as exceptions
+    LoadedContent failed;
+    failed.filePath = filePath;
+    failed.error = QString::fromUtf8(e.what());
+    failed.decodeMs = timer.nsecsElapsed() / 1e6;
+    return failed;
+  }
+  content.decodeMs = timer.nsecsElapsed() / 1e6;
+  return content;
+}
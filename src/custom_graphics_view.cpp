@@ -1,14 +1,50 @@
 #include "custom_graphics_view.h"
+#include "render_thread.h"
 #include <QApplication>
+#include <QElapsedTimer>
 #include <QGraphicsScene>
 #include <QPainter>
+#include <QScreen>
 #include <QScrollBar>
+#include <QThread>
 #include <cmath>
 
+namespace {
+
+// How long the view must be still before the full-quality repaint
+constexpr int kDefaultSettleDelay = 150;
+
+constexpr qreal kDefaultRefreshRate = 60.0;
+
+// Fraction of the remaining distance to the target covered by each frame
+// of a smooth zoom
+constexpr qreal kSmoothZoomStep = 0.35;
+
+} // namespace
+
 CustomGraphicsView::CustomGraphicsView(QWidget *parent)
     : QGraphicsView(parent), m_currentZoom(1.0), m_originalImageSize(0, 0),
-      m_currentViewSize(0, 0), m_currentTransform() {
+      m_currentViewSize(0, 0), m_currentTransform(),
+      m_renderQuality(RenderQuality::Full), m_queuedZoomSteps(0.0),
+      m_smoothZoom(false), m_targetZoom(1.0), m_gestureWheelEvents(0),
+      m_gestureRepaints(0), m_resizeZoom(1.0),
+      m_renderMode(RenderMode::Direct), m_renderThread(nullptr),
+      m_lastShownFrame(0) {
   setupGraphicsView();
+
+  m_resizeTimer.setSingleShot(true);
+  m_resizeTimer.setTimerType(Qt::PreciseTimer);
+  connect(&m_resizeTimer, &QTimer::timeout, this,
+          &CustomGraphicsView::applyPendingResize);
+
+  m_zoomTimer.setTimerType(Qt::PreciseTimer);
+  connect(&m_zoomTimer, &QTimer::timeout, this,
+          &CustomGraphicsView::applyQueuedZoom);
+
+  m_settleTimer.setSingleShot(true);
+  m_settleTimer.setInterval(kDefaultSettleDelay);
+  connect(&m_settleTimer, &QTimer::timeout, this,
+          [this]() { setRenderQuality(RenderQuality::Full); });
 }
 
 void CustomGraphicsView::setupGraphicsView() {
@@ -24,6 +60,108 @@ void CustomGraphicsView::setupGraphicsView() {
   setMouseTracking(true);
 }
 
+void CustomGraphicsView::beginMotion() {
+  m_snapshot = QPixmap();
+  setRenderQuality(RenderQuality::Draft);
+  m_settleTimer.start();
+}
+
+QRectF CustomGraphicsView::sceneRectFor(const QPointF &center,
+                                        qreal zoom) const {
+  zoom = qBound(m_minZoom, zoom, m_maxZoom);
+  const QSizeF size = QSizeF(viewport()->size()) / zoom;
+  return QRectF(center - QPointF(size.width() / 2, size.height() / 2), size);
+}
+
+QColor CustomGraphicsView::backgroundColor() const {
+  return viewport()->palette().color(viewport()->backgroundRole());
+}
+
+RenderThread::Request
+CustomGraphicsView::snapshotRequest(std::shared_ptr<RenderSource> source,
+                                    const QRectF &sceneRect) const {
+  RenderThread::Request request;
+  request.source = std::move(source);
+  request.sceneRect = sceneRect;
+  request.size = viewport()->size();
+  request.devicePixelRatio = viewport()->devicePixelRatioF();
+  request.hints = QPainter::Antialiasing | QPainter::SmoothPixmapTransform;
+  request.background = backgroundColor();
+  return request;
+}
+
+QImage CustomGraphicsView::renderSnapshot(
+    const RenderThread::Request &request) {
+  QImage image(request.size * request.devicePixelRatio,
+               QImage::Format_ARGB32_Premultiplied);
+  image.setDevicePixelRatio(request.devicePixelRatio);
+  renderFrame(*request.source, image, request.sceneRect,
+              QRect(QPoint(0, 0), request.size), request.hints,
+              request.background);
+  return image;
+}
+
+bool CustomGraphicsView::showSnapshot(const QPixmap &snapshot,
+                                      const QRectF &sceneRect) {
+  // Half a device pixel of disagreement would already be visible
+  const QRectF shown = visibleSceneRect();
+  const qreal tolerance = 0.5 / (m_currentZoom * devicePixelRatioF());
+  if (snapshot.deviceIndependentSize() != QSizeF(viewport()->size()) ||
+      qAbs(shown.left() - sceneRect.left()) > tolerance ||
+      qAbs(shown.top() - sceneRect.top()) > tolerance) {
+    return false;
+  }
+  m_snapshot = snapshot;
+  viewport()->update();
+  return true;
+}
+
+void CustomGraphicsView::clearSnapshot() {
+  if (!m_snapshot.isNull()) {
+    m_snapshot = QPixmap();
+    viewport()->update();
+  }
+}
+
+void CustomGraphicsView::setRenderQuality(RenderQuality quality) {
+  if (quality == m_renderQuality) {
+    return;
+  }
+  m_renderQuality = quality;
+  m_snapshot = QPixmap();
+
+  const bool full = quality == RenderQuality::Full;
+  setRenderHint(QPainter::Antialiasing, full);
+  setRenderHint(QPainter::SmoothPixmapTransform, full);
+  if (full) {
+    // The settle pass: redraw everything that was drafted
+    viewport()->update();
+    if (m_gestureWheelEvents > 0) {
+      emit zoomGestureFinished(m_gestureWheelEvents, m_gestureRepaints);
+      m_gestureWheelEvents = 0;
+      m_gestureRepaints = 0;
+    }
+  }
+  emit renderQualityChanged(quality);
+}
+
+void CustomGraphicsView::setRenderMode(RenderMode mode) {
+  m_renderMode = mode;
+  if (mode == RenderMode::Threaded && !m_renderThread) {
+    m_renderThread = new RenderThread(this);
+    // Queued: the frame arrives from the worker thread
+    connect(m_renderThread, &RenderThread::frameReady, this,
+            [this]() { viewport()->update(); }, Qt::QueuedConnection);
+  }
+  viewport()->update();
+}
+
+void CustomGraphicsView::setRenderSource(
+    std::shared_ptr<RenderSource> source) {
+  m_renderSource = std::move(source);
+  viewport()->update();
+}
+
 void CustomGraphicsView::setOriginalImageSize(const QSize &size) {
   m_originalImageSize = size;
   m_currentViewSize = viewport()->size();
@@ -31,26 +169,26 @@ void CustomGraphicsView::setOriginalImageSize(const QSize &size) {
 }
 
 void CustomGraphicsView::setInitialZoom() {
-  if (scene() && !scene()->items().isEmpty()) {
-    m_currentTransform = QTransform();
-    setTransform(m_currentTransform);
-    updateScaling();
-    centerOn(scene()->sceneRect().center());
+  if (scene() && !scene()->items().isEmpty() &&
+      m_originalImageSize.isValid() && !m_currentViewSize.isEmpty()) {
+    setViewState(scene()->sceneRect().center(), fitZoom(m_currentViewSize));
   }
 }
 
-void CustomGraphicsView::updateScaling() {
-  if (m_originalImageSize.isValid() && !m_currentViewSize.isEmpty()) {
-    // Calculate scale ratios for both width and height
-    qreal scaleX = static_cast<qreal>(m_currentViewSize.width()) /
-                   m_originalImageSize.width();
-    qreal scaleY = static_cast<qreal>(m_currentViewSize.height()) /
-                   m_originalImageSize.height();
+qreal CustomGraphicsView::fitZoom(const QSize &viewSize) const {
+  // Calculate scale ratios for both width and height
+  qreal scaleX =
+      static_cast<qreal>(viewSize.width()) / m_originalImageSize.width();
+  qreal scaleY =
+      static_cast<qreal>(viewSize.height()) / m_originalImageSize.height();
 
-    // Use the smaller scale to ensure image fits in both dimensions
-    qreal scale = qMin(scaleX, scaleY);
+  // Use the smaller scale to ensure image fits in both dimensions
+  return qMin(scaleX, scaleY);
+}
 
-    scale = qBound(m_minZoom, scale, m_maxZoom);
+void CustomGraphicsView::updateScaling() {
+  if (m_originalImageSize.isValid() && !m_currentViewSize.isEmpty()) {
+    qreal scale = qBound(m_minZoom, fitZoom(m_currentViewSize), m_maxZoom);
 
     m_currentTransform = QTransform::fromScale(scale, scale);
     setTransform(m_currentTransform);
@@ -60,28 +198,57 @@ void CustomGraphicsView::updateScaling() {
 }
 
 void CustomGraphicsView::resizeEvent(QResizeEvent *event) {
+  m_snapshot = QPixmap();
   QGraphicsView::resizeEvent(event);
+  const QSize oldViewSize = m_currentViewSize;
   m_currentViewSize = event->size();
 
-  // Preserve the current center point
-  QPointF centerPoint = mapToScene(viewport()->rect().center());
+  if (m_originalImageSize.isEmpty() || oldViewSize.isEmpty() ||
+      m_currentViewSize.isEmpty()) {
+    return;
+  }
 
-  // Update scaling while maintaining the current zoom level
-  qreal scaleX = static_cast<qreal>(m_currentViewSize.width()) /
-                 m_originalImageSize.width();
-  qreal scaleY = static_cast<qreal>(m_currentViewSize.height()) /
-                 m_originalImageSize.height();
-  qreal scale = qMin(scaleX, scaleY);
+  if (!m_resizeTimer.isActive()) {
+    // First event of a burst: preserve the current center point
+    m_resizeFromSize = oldViewSize;
+    m_resizeCenter = mapToScene(viewport()->rect().center());
+    m_resizeZoom = m_currentZoom;
+    m_resizeTimer.start(frameInterval());
+  }
+  // Frames until the size settles are drafted
+  beginMotion();
+}
 
-  // Apply the current zoom to the new scale
-  scale *= m_currentZoom;
+void CustomGraphicsView::applyPendingResize() {
+  if (m_currentViewSize.isEmpty()) {
+    return;
+  }
+  // Keep the zoom relative to the fitted size, so the same part of the
+  // image stays visible
+  qreal zoom = m_resizeZoom * fitZoom(m_currentViewSize) /
+               fitZoom(m_resizeFromSize);
+  setViewState(m_resizeCenter, zoom);
+}
 
-  // Update the transform
-  m_currentTransform = QTransform::fromScale(scale, scale);
-  setTransform(m_currentTransform);
+void CustomGraphicsView::setViewState(const QPointF &center, qreal zoom) {
+  // A view state set during a resize burst already accounts for the new
+  // size; restoring the state captured before the burst would undo it
+  m_resizeTimer.stop();
+  // A snapshot only matches the view state it was shown for
+  m_snapshot = QPixmap();
+  zoom = qBound(m_minZoom, zoom, m_maxZoom);
+  m_currentTransform = QTransform::fromScale(zoom, zoom);
+  m_currentZoom = zoom;
 
-  // Center on the previous center point
-  centerOn(centerPoint);
+  // setTransform() and centerOn() each invalidate the viewport, and the
+  // scroll can blit the intermediate state. Hold updates back while both
+  // are applied, then repaint once.
+  const bool updatesEnabled = viewport()->updatesEnabled();
+  viewport()->setUpdatesEnabled(false);
+  setTransform(m_currentTransform);
+  centerOn(center);
+  viewport()->setUpdatesEnabled(updatesEnabled);
+  viewport()->update();
 }
 
 QPointF
@@ -103,36 +270,164 @@ CustomGraphicsView::mapFromImageCoordinates(const QPointF &imagePoint) const {
   return mapFromScene(scenePoint);
 }
 
-void CustomGraphicsView::setZoom(qreal zoom) {
-  zoom = qBound(m_minZoom, zoom, m_maxZoom);
-  qreal factor = zoom / m_currentZoom;
-  m_currentTransform.scale(factor, factor);
-  setTransform(m_currentTransform);
-  m_currentZoom = zoom;
-}
-
 void CustomGraphicsView::wheelEvent(QWheelEvent *event) {
+  beginMotion();
   if (QApplication::keyboardModifiers() == Qt::ControlModifier) {
-    double delta = event->angleDelta().y() / 120.0;
-    double factor = std::pow(m_zoomFactor, delta);
-    zoomView(factor);
+    // Touchpads send many small deltas per frame; only queue them here
+    if (!m_zoomTimer.isActive()) {
+      if (m_gestureWheelEvents == 0) {
+        m_gestureRepaints = 0;
+      }
+      m_targetZoom = m_currentZoom;
+      m_zoomTimer.start(frameInterval());
+    }
+    m_queuedZoomSteps += event->angleDelta().y() / 120.0;
+    m_zoomAnchor = event->position();
+    ++m_gestureWheelEvents;
     event->accept();
   } else {
     QGraphicsView::wheelEvent(event);
   }
 }
 
-void CustomGraphicsView::zoomView(double factor) {
-  double newZoom = m_currentZoom * factor;
-  newZoom = qBound(m_minZoom, newZoom, m_maxZoom);
-  double actualFactor = newZoom / m_currentZoom;
+int CustomGraphicsView::frameInterval() const {
+  qreal refreshRate = screen() ? screen()->refreshRate() : 0.0;
+  if (refreshRate <= 0.0) {
+    refreshRate = kDefaultRefreshRate;
+  }
+  return qMax(1, qRound(1000.0 / refreshRate));
+}
+
+void CustomGraphicsView::applyQueuedZoom() {
+  if (m_queuedZoomSteps != 0.0) {
+    beginMotion();
+    m_targetZoom = qBound(m_minZoom,
+                          m_targetZoom * std::pow(m_zoomFactor,
+                                                  m_queuedZoomSteps),
+                          m_maxZoom);
+    m_queuedZoomSteps = 0.0;
+  }
+
+  qreal zoom = m_targetZoom;
+  if (m_smoothZoom) {
+    zoom = m_currentZoom + (m_targetZoom - m_currentZoom) * kSmoothZoomStep;
+    // Snap once the remaining step is below a thousandth
+    if (qAbs(m_targetZoom - zoom) <= m_targetZoom * 1e-3) {
+      zoom = m_targetZoom;
+    }
+  }
 
-  m_currentTransform.scale(actualFactor, actualFactor);
-  setTransform(m_currentTransform);
-  m_currentZoom = newZoom;
+  if (zoom != m_currentZoom) {
+    beginMotion();
+    zoomAround(zoom, m_zoomAnchor);
+  }
+  if (m_currentZoom == m_targetZoom) {
+    m_zoomTimer.stop();
+  }
+}
+
+void CustomGraphicsView::zoomAround(qreal zoom, const QPointF &anchor) {
+  // Keep the scene point under `anchor` in place
+  const QPointF scenePoint = viewportTransform().inverted().map(anchor);
+  zoom = qBound(m_minZoom, zoom, m_maxZoom);
+  const QPointF offset = anchor - QRectF(viewport()->rect()).center();
+  setViewState(scenePoint - offset / zoom, zoom);
+}
+
+void CustomGraphicsView::paintEvent(QPaintEvent *event) {
+  QElapsedTimer timer;
+  timer.start();
+  // A snapshot rendered for another screen density would look wrong
+  if (!m_snapshot.isNull() &&
+      m_snapshot.devicePixelRatio() != viewport()->devicePixelRatioF()) {
+    m_snapshot = QPixmap();
+  }
+  // Rendering done off the GUI thread for this frame
+  qint64 renderNsecs = 0;
+  bool newFrame = true;
+  if (!m_snapshot.isNull()) {
+    QPainter painter(viewport());
+    painter.drawPixmap(QPointF(0, 0), m_snapshot);
+  } else if (m_renderMode == RenderMode::Parallel && m_renderSource) {
+    paintParallel(event);
+  } else if (m_renderMode == RenderMode::Threaded && m_renderSource) {
+    newFrame = paintThreaded(event, renderNsecs);
+  } else {
+    QGraphicsView::paintEvent(event);
+  }
+  if (m_gestureWheelEvents > 0) {
+    ++m_gestureRepaints;
+  }
+  if (newFrame) {
+    emit frameRendered(renderNsecs + timer.nsecsElapsed());
+  }
+}
+
+QRectF CustomGraphicsView::visibleSceneRect() const {
+  return viewportTransform().inverted().mapRect(QRectF(viewport()->rect()));
+}
+
+void CustomGraphicsView::paintParallel(QPaintEvent *event) {
+  const qreal dpr = viewport()->devicePixelRatioF();
+  const QSize pixelSize = viewport()->size() * dpr;
+  if (m_parallelFrame.size() != pixelSize) {
+    m_parallelFrame = QImage(pixelSize, QImage::Format_ARGB32_Premultiplied);
+  }
+  m_parallelFrame.setDevicePixelRatio(dpr);
+
+  // One band per core; the GUI thread waits for all of them
+  const QRect area = event->rect();
+  renderFrame(*m_renderSource, m_parallelFrame, visibleSceneRect(), area,
+              renderHints(), backgroundColor(), QThread::idealThreadCount());
+
+  QPainter painter(viewport());
+  painter.drawImage(QRectF(area), m_parallelFrame,
+                    QRectF(QPointF(area.topLeft()) * dpr,
+                           QSizeF(area.size()) * dpr));
+}
+
+bool CustomGraphicsView::paintThreaded(QPaintEvent *event,
+                                       qint64 &renderNsecs) {
+  RenderThread::Request request;
+  request.source = m_renderSource;
+  request.sceneRect = visibleSceneRect();
+  request.size = viewport()->size();
+  request.devicePixelRatio = viewport()->devicePixelRatioF();
+  request.hints = renderHints();
+  request.background = backgroundColor();
+  // Every finished frame triggers a paint event; only a changed view
+  // needs a new frame
+  if (!(request == m_lastRequest)) {
+    m_lastRequest = request;
+    m_renderThread->request(request);
+  }
+
+  // Show the latest frame where its scene area now is on screen, so panning
+  // and zooming respond before the worker catches up
+  const RenderThread::Frame frame = m_renderThread->latestFrame();
+  QPainter painter(viewport());
+  painter.fillRect(event->rect(), request.background);
+  if (!frame.image.isNull()) {
+    painter.setRenderHint(QPainter::SmoothPixmapTransform,
+                          frame.sceneRect != request.sceneRect);
+    painter.drawImage(viewportTransform().mapRect(frame.sceneRect),
+                      frame.image);
+  }
+
+  // Paints that only show the same frame again cost nothing worth timing
+  if (frame.serial == m_lastShownFrame) {
+    return false;
+  }
+  m_lastShownFrame = frame.serial;
+  renderNsecs = frame.renderNsecs;
+  return true;
 }
 
 void CustomGraphicsView::mouseMoveEvent(QMouseEvent *event) {
+  if (event->buttons() & Qt::LeftButton) {
+    // Drag-panning
+    beginMotion();
+  }
   QGraphicsView::mouseMoveEvent(event);
   emit mouseMoved();
 }
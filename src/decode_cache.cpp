@@ -0,0 +1,242 @@
+#include "decode_cache.h"
+#include "utils.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+constexpr char kMagic[8] = {'N', 'E', 'A', 'T', 'R', 'A', 'W', '1'};
+constexpr char kSuffix[] = ".raw";
+
+// Scanlines start at this offset alignment, which keeps every row aligned
+// for the SIMD kernels
+constexpr qint64 kDataAlignment = 64;
+
+// Bytes of the source file hashed into its key. With the size and the
+// modification time this tells apart files rewritten with their old
+// timestamp, without reading large files in full on every load.
+constexpr qint64 kKeyPrefixBytes = qint64(64) << 10;
+
+// Decoding these is faster than a disk round trip
+constexpr qint64 kMinCachedBytes = qint64(1) << 20;
+
+// QSaveFile's temporary files older than this belong to writes that never
+// committed, e.g. because the process crashed; younger ones may still be
+// being written by another instance
+constexpr qint64 kStaleTempFileSecs = 60 * 60;
+
+// Fixed-size, native-endian header at the start of every entry. The cache
+// never leaves the machine that wrote it.
+struct Header {
+  char magic[8];
+  std::uint32_t format;
+  std::uint32_t width;
+  std::uint32_t height;
+  std::uint32_t bytesPerLine;
+  std::uint32_t colorCount;
+  std::uint32_t reserved;
+  std::int32_t dotsPerMeterX;
+  std::int32_t dotsPerMeterY;
+  std::uint64_t dataOffset;
+};
+
+qint64 alignUp(qint64 value) {
+  return (value + kDataAlignment - 1) & ~(kDataAlignment - 1);
+}
+
+bool isValidHeader(const Header &header, qint64 fileSize) {
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.format == QImage::Format_Invalid ||
+      header.format >= QImage::NImageFormats || header.width == 0 ||
+      header.height == 0 || header.width > INT_MAX ||
+      header.height > INT_MAX || header.bytesPerLine > INT_MAX ||
+      header.colorCount > 256) {
+    return false;
+  }
+  // Rows must hold `width` pixels of the format
+  const int depth =
+      QImage::toPixelFormat(static_cast<QImage::Format>(header.format))
+          .bitsPerPixel();
+  if (depth <= 0 ||
+      qint64(header.bytesPerLine) < (qint64(header.width) * depth + 7) / 8) {
+    return false;
+  }
+  const qint64 tableEnd =
+      qint64(sizeof(Header)) + qint64(header.colorCount) * sizeof(QRgb);
+  const qint64 dataBytes = qint64(header.bytesPerLine) * header.height;
+  return qint64(header.dataOffset) >= tableEnd &&
+         header.dataOffset % kDataAlignment == 0 &&
+         qint64(header.dataOffset) + dataBytes <= fileSize;
+}
+
+} // namespace
+
+DecodeCache::DecodeCache(const QString &directory, qint64 maxBytes)
+    : m_directory(directory), m_maxBytes(maxBytes) {
+  if (isEnabled()) {
+    QDir().mkpath(m_directory);
+  }
+  // One writer: entries are written one after another, never competing
+  // with each other or with decodes for the disk
+  m_writer.setMaxThreadCount(1);
+  m_writer.setThreadPriority(QThread::LowPriority);
+}
+
+DecodeCache &DecodeCache::instance() {
+  static DecodeCache cache(
+      QString::fromStdString(utils::ensure_neat_directory()) +
+          "/decode-cache",
+      static_cast<qint64>(utils::decode_cache_max_bytes()));
+  return cache;
+}
+
+QByteArray DecodeCache::keyFor(const QString &filePath) {
+  const QFileInfo info(filePath);
+  QFile file(filePath);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return QByteArray();
+  }
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(info.absoluteFilePath().toUtf8());
+  hash.addData(QByteArray::number(info.size()));
+  hash.addData(file.read(kKeyPrefixBytes));
+  return hash.result().toHex() + '-' +
+         QByteArray::number(info.lastModified().toMSecsSinceEpoch());
+}
+
+QString DecodeCache::entryPath(const QByteArray &key) const {
+  return m_directory + '/' + QString::fromLatin1(key) + kSuffix;
+}
+
+QImage DecodeCache::find(const QByteArray &key) {
+  if (!isEnabled()) {
+    return QImage();
+  }
+
+  // Owned by the returned image; closing it unmaps the pixels
+  auto *file = new QFile(entryPath(key));
+  Header header;
+  if (!file->open(QIODevice::ReadOnly) ||
+      file->read(reinterpret_cast<char *>(&header), sizeof(header)) !=
+          qint64(sizeof(header)) ||
+      !isValidHeader(header, file->size())) {
+    delete file;
+    return QImage();
+  }
+
+  QList<QRgb> colorTable(header.colorCount);
+  const qint64 tableBytes = qint64(header.colorCount) * sizeof(QRgb);
+  if (file->read(reinterpret_cast<char *>(colorTable.data()), tableBytes) !=
+      tableBytes) {
+    delete file;
+    return QImage();
+  }
+
+  const qint64 dataBytes = qint64(header.bytesPerLine) * header.height;
+  const uchar *pixels = file->map(header.dataOffset, dataBytes);
+  if (!pixels) {
+    delete file;
+    return QImage();
+  }
+
+  // Counts as a use for the LRU order
+  file->setFileTime(QDateTime::currentDateTimeUtc(),
+                    QFileDevice::FileModificationTime);
+
+  QImage image(
+      pixels, header.width, header.height, header.bytesPerLine,
+      static_cast<QImage::Format>(header.format),
+      [](void *info) { delete static_cast<QFile *>(info); }, file);
+  // A null image never takes ownership of the mapping
+  if (image.isNull()) {
+    delete file;
+    return QImage();
+  }
+  if (!colorTable.isEmpty()) {
+    image.setColorTable(colorTable);
+  }
+  image.setDotsPerMeterX(header.dotsPerMeterX);
+  image.setDotsPerMeterY(header.dotsPerMeterY);
+  return image;
+}
+
+bool DecodeCache::insert(const QByteArray &key, const QImage &image) {
+  if (!isEnabled() || image.isNull() ||
+      image.sizeInBytes() < kMinCachedBytes ||
+      image.sizeInBytes() > m_maxBytes) {
+    return false;
+  }
+
+  const QList<QRgb> colorTable = image.colorTable();
+  Header header = {};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.format = image.format();
+  header.width = image.width();
+  header.height = image.height();
+  header.bytesPerLine = image.bytesPerLine();
+  header.colorCount = colorTable.size();
+  header.dotsPerMeterX = image.dotsPerMeterX();
+  header.dotsPerMeterY = image.dotsPerMeterY();
+  header.dataOffset = alignUp(qint64(sizeof(header)) +
+                              qint64(colorTable.size()) * sizeof(QRgb));
+
+  // Readers never see a partly written entry
+  QSaveFile file(entryPath(key));
+  if (!file.open(QIODevice::WriteOnly)) {
+    return false;
+  }
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(colorTable.constData()),
+             qint64(colorTable.size()) * sizeof(QRgb));
+  file.write(QByteArray(header.dataOffset - file.pos(), '\0'));
+  file.write(reinterpret_cast<const char *>(image.constBits()),
+             image.sizeInBytes());
+  if (!file.commit()) {
+    return false;
+  }
+
+  evict();
+  return true;
+}
+
+void DecodeCache::insertLater(const QByteArray &key, const QImage &image) {
+  if (!isEnabled()) {
+    return;
+  }
+  m_writer.start([this, key, image]() { insert(key, image); });
+}
+
+void DecodeCache::evict() {
+  QMutexLocker locker(&m_evictMutex);
+  const QDir directory(m_directory);
+
+  // Temporary files are named <entry>.XXXXXX, which the entry pattern
+  // below never matches, so stale ones are swept here
+  const QDateTime staleBefore =
+      QDateTime::currentDateTimeUtc().addSecs(-kStaleTempFileSecs);
+  for (const QFileInfo &temporary : directory.entryInfoList(
+           {QString("*") + kSuffix + ".*"}, QDir::Files)) {
+    if (temporary.lastModified() < staleBefore) {
+      QFile::remove(temporary.filePath());
+    }
+  }
+
+  // Most recently used first
+  const QFileInfoList entries = directory.entryInfoList(
+      {QString("*") + kSuffix}, QDir::Files, QDir::Time);
+  qint64 total = 0;
+  for (const QFileInfo &entry : entries) {
+    total += entry.size();
+    // Mapped entries stay readable after removal until they are unmapped
+    if (total > m_maxBytes) {
+      QFile::remove(entry.filePath());
+    }
+  }
+}
@@ -0,0 +1,203 @@
+#include "image_compaction.h"
+#include "raster_conversion.h"
+#include <QList>
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+constexpr int kMaxPaletteSize = 256;
+
+// Open-addressing set of at most kMaxPaletteSize colours, remembering the
+// palette index given to each one
+class ColorTable {
+public:
+  ColorTable() : m_count(0) { m_used.fill(false); }
+
+  // Returns false once the colour would not fit in the palette
+  bool insert(std::uint32_t color) {
+    std::size_t slot = hash(color);
+    while (m_used[slot]) {
+      if (m_keys[slot] == color) {
+        return true;
+      }
+      slot = (slot + 1) & kMask;
+    }
+    if (m_count == kMaxPaletteSize) {
+      return false;
+    }
+    m_used[slot] = true;
+    m_keys[slot] = color;
+    m_indices[slot] = static_cast<std::uint8_t>(m_count);
+    m_palette[m_count++] = color;
+    return true;
+  }
+
+  std::uint8_t indexOf(std::uint32_t color) const {
+    std::size_t slot = hash(color);
+    while (m_keys[slot] != color) {
+      slot = (slot + 1) & kMask;
+    }
+    return m_indices[slot];
+  }
+
+  int size() const { return m_count; }
+
+  QList<QRgb> palette() const {
+    return QList<QRgb>(m_palette.begin(), m_palette.begin() + m_count);
+  }
+
+private:
+  // Four times the palette size keeps probe sequences short
+  static constexpr std::size_t kSlots = 4 * kMaxPaletteSize;
+  static constexpr std::size_t kMask = kSlots - 1;
+
+  static std::size_t hash(std::uint32_t color) {
+    return (color * 0x9E3779B1u) >> 22;
+  }
+
+  std::array<bool, kSlots> m_used;
+  std::array<std::uint32_t, kSlots> m_keys;
+  std::array<std::uint8_t, kSlots> m_indices;
+  std::array<std::uint32_t, kMaxPaletteSize> m_palette;
+  int m_count;
+};
+
+struct ScanResult {
+  bool opaque;
+  bool grayscale;
+  bool fitsPalette;
+};
+
+// One pass over 32-bit pixels. The alpha/grayscale checks are branch-free
+// so the compiler vectorizes them; the palette is only probed at colour
+// changes, which are rare in flat-colour diagrams.
+ScanResult scanPixels(const QImage &image, ColorTable &colors) {
+  std::uint32_t alphaAnd = 0xff000000u;
+  std::uint32_t notGray = 0;
+  bool fitsPalette = true;
+
+  const int width = image.width();
+  for (int y = 0; y < image.height(); ++y) {
+    const auto *line =
+        reinterpret_cast<const std::uint32_t *>(image.constScanLine(y));
+
+    for (int x = 0; x < width; ++x) {
+      const std::uint32_t pixel = line[x];
+      alphaAnd &= pixel;
+      notGray |= ((pixel >> 16) ^ (pixel >> 8)) & 0xff;
+      notGray |= ((pixel >> 8) ^ pixel) & 0xff;
+    }
+
+    if (fitsPalette) {
+      std::uint32_t last = line[0];
+      fitsPalette = colors.insert(last);
+      for (int x = 1; x < width && fitsPalette; ++x) {
+        if (line[x] != last) {
+          last = line[x];
+          fitsPalette = colors.insert(last);
+        }
+      }
+    }
+
+    // Neither a palette nor grayscale is possible any more
+    if (!fitsPalette && notGray) {
+      break;
+    }
+  }
+
+  return {(alphaAnd & 0xff000000u) == 0xff000000u, notGray == 0, fitsPalette};
+}
+
+QImage toMono(const QImage &image, const ColorTable &colors) {
+  QImage result(image.size(), QImage::Format_Mono);
+  QList<QRgb> palette = colors.palette();
+  if (palette.size() == 1) {
+    palette.append(palette.first());
+  }
+  result.setColorTable(palette);
+
+  const std::uint32_t one = palette.at(1);
+  for (int y = 0; y < image.height(); ++y) {
+    const auto *in =
+        reinterpret_cast<const std::uint32_t *>(image.constScanLine(y));
+    uchar *out = result.scanLine(y);
+    std::memset(out, 0, result.bytesPerLine());
+    for (int x = 0; x < image.width(); ++x) {
+      if (in[x] == one) {
+        out[x >> 3] |= 0x80 >> (x & 7);
+      }
+    }
+  }
+  return result;
+}
+
+QImage toGrayscale8(const QImage &image) {
+  QImage result(image.size(), QImage::Format_Grayscale8);
+  for (int y = 0; y < image.height(); ++y) {
+    const auto *in =
+        reinterpret_cast<const std::uint32_t *>(image.constScanLine(y));
+    uchar *out = result.scanLine(y);
+    for (int x = 0; x < image.width(); ++x) {
+      out[x] = static_cast<uchar>(in[x]);
+    }
+  }
+  return result;
+}
+
+QImage toIndexed8(const QImage &image, const ColorTable &colors) {
+  QImage result(image.size(), QImage::Format_Indexed8);
+  result.setColorTable(colors.palette());
+  for (int y = 0; y < image.height(); ++y) {
+    const auto *in =
+        reinterpret_cast<const std::uint32_t *>(image.constScanLine(y));
+    uchar *out = result.scanLine(y);
+    std::uint32_t last = in[0];
+    uchar index = colors.indexOf(last);
+    for (int x = 0; x < image.width(); ++x) {
+      if (in[x] != last) {
+        last = in[x];
+        index = colors.indexOf(last);
+      }
+      out[x] = index;
+    }
+  }
+  return result;
+}
+
+} // namespace
+
+bool isCompactFormat(QImage::Format format) {
+  return format == QImage::Format_Mono || format == QImage::Format_MonoLSB ||
+         format == QImage::Format_Indexed8 ||
+         format == QImage::Format_Grayscale8;
+}
+
+QImage compactImage(QImage image) {
+  if (image.isNull() || isCompactFormat(image.format())) {
+    return image;
+  }
+
+  // Work on straight (non-premultiplied) 32-bit pixels, which is also what
+  // a colour table holds
+  image = toStraight32(std::move(image));
+
+  ColorTable colors;
+  const ScanResult scan = scanPixels(image, colors);
+
+  QImage result;
+  if (scan.fitsPalette && colors.size() <= 2) {
+    result = toMono(image, colors);
+  } else if (scan.opaque && scan.grayscale) {
+    result = toGrayscale8(image);
+  } else if (scan.fitsPalette) {
+    result = toIndexed8(image, colors);
+  } else {
+    return image;
+  }
+
+  result.setDotsPerMeterX(image.dotsPerMeterX());
+  result.setDotsPerMeterY(image.dotsPerMeterY());
+  return result;
+}
@@ -0,0 +1,121 @@
+#include "image_decoder.h"
+#include "raster_conversion.h"
+#include <QBuffer>
+#include <QFile>
+#include <QImageIOHandler>
+#include <QImageReader>
+
+std::shared_ptr<ImageDecoder> ImageDecoder::fromFile(const QString &filePath) {
+  return std::make_shared<QtImageDecoder>(filePath);
+}
+
+std::shared_ptr<ImageDecoder> ImageDecoder::fromData(QByteArray data,
+                                                     const QString &format) {
+  return std::make_shared<QtImageDecoder>(std::move(data), format);
+}
+
+std::shared_ptr<ImageDecoder> ImageDecoder::fromImage(QImage image,
+                                                      const QString &format) {
+  return std::make_shared<MemoryImageDecoder>(std::move(image), format);
+}
+
+QtImageDecoder::QtImageDecoder(const QString &filePath)
+    : m_filePath(filePath), m_capabilities(NoCapabilities), m_canRead(false) {
+  probe();
+}
+
+QtImageDecoder::QtImageDecoder(QByteArray data, const QString &format)
+    : m_data(std::move(data)), m_format(format),
+      m_capabilities(NoCapabilities), m_canRead(false) {
+  probe();
+}
+
+void QtImageDecoder::setupReader(QImageReader &reader, QBuffer &buffer) const {
+  if (m_filePath.isEmpty()) {
+    buffer.setData(m_data);
+    buffer.open(QIODevice::ReadOnly);
+    reader.setDevice(&buffer);
+    reader.setFormat(m_format.toUtf8());
+  } else {
+    reader.setFileName(m_filePath);
+  }
+}
+
+void QtImageDecoder::probe() {
+  QBuffer buffer;
+  QImageReader reader;
+  setupReader(reader, buffer);
+
+  m_canRead = reader.canRead();
+  if (!m_canRead) {
+    return;
+  }
+
+  // Only the header is parsed here; no pixels are decoded
+  m_size = reader.size();
+  m_format = QString::fromUtf8(reader.format());
+
+  if (reader.supportsOption(QImageIOHandler::ClipRect)) {
+    m_capabilities |= RegionDecode;
+  }
+  if (reader.supportsOption(QImageIOHandler::ScaledSize)) {
+    m_capabilities |= ScaledDecode;
+  }
+}
+
+QImage QtImageDecoder::read(const QRect &region,
+                            const QSize &scaledSize) const {
+  QBuffer buffer;
+  QImageReader reader;
+  setupReader(reader, buffer);
+
+  if (!region.isNull() && region != QRect(QPoint(0, 0), m_size)) {
+    reader.setClipRect(region);
+  }
+  if (scaledSize.isValid()) {
+    reader.setScaledSize(scaledSize);
+  }
+  return reader.read();
+}
+
+QByteArray QtImageDecoder::encodedData() const {
+  if (m_filePath.isEmpty()) {
+    return m_data;
+  }
+  QFile file(m_filePath);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return QByteArray();
+  }
+  return file.readAll();
+}
+
+MemoryImageDecoder::MemoryImageDecoder(QImage image, const QString &format)
+    : m_image(std::move(image)), m_format(format) {}
+
+QImage MemoryImageDecoder::read(const QRect &region,
+                                const QSize &scaledSize) const {
+  QImage result = region.isNull() ? m_image : m_image.copy(region);
+  if (!scaledSize.isValid() || scaledSize == result.size()) {
+    return result;
+  }
+
+  // Pyramid levels are exact halvings, done with the box-filter kernels
+  int levels = 0;
+  if (isHalvedSize(result.size(), scaledSize, levels)) {
+    result = toDisplayFormat(std::move(result));
+    for (int i = 0; i < levels; ++i) {
+      result = downsample2x(result);
+    }
+    return result;
+  }
+  return result.scaled(scaledSize, Qt::IgnoreAspectRatio,
+                       Qt::SmoothTransformation);
+}
+
+QByteArray MemoryImageDecoder::encodedData() const {
+  QByteArray data;
+  QBuffer buffer(&data);
+  buffer.open(QIODevice::WriteOnly);
+  m_image.save(&buffer, m_format.toUtf8().constData());
+  return data;
+}
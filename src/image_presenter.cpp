@@ -1,9 +1,13 @@
 #include "image_presenter.h"
+#include "content_loader.h"
+#include "session_logger.h"
+#include "startup_trace.h"
+#include "state_store.h"
 #include "utils.h"
 #include <QApplication>
 #include <QBuffer>
-#include <QDomDocument>
 #include <QFileDialog>
+#include <QFutureWatcher>
 #include <QGraphicsPixmapItem>
 #include <QGraphicsSvgItem>
 #include <QImageReader>
@@ -14,16 +18,45 @@
 #include <QScreen>
 #include <QSvgGenerator>
 #include <QSvgRenderer>
-#include <QTemporaryFile>
+#include <QtConcurrent/QtConcurrentRun>
+#include <algorithm>
+#include <climits>
 #include <cmath>
+#include <limits>
 
-ImagePresenter::ImagePresenter() : QMainWindow() {
+namespace {
+
+// Intermediate view states sampled on the way to a neighbouring point when
+// prefetching the tiles an animation will pass over
+constexpr int kPrefetchPathSteps = 3;
+
+// Time without mouse or keyboard activity before the top bar and cursor
+// are hidden
+constexpr int kHideDelay = 5000;
+
+// Upper bound for the presentation point snapshots; a 4K viewport takes
+// about 32 MiB per point
+constexpr qint64 kMaxSnapshotBytes = qint64(256) << 20;
+
+// Loads `filePath` on the thread pool
+QFuture<LoadedContent> startLoad(const QString &filePath) {
+  return QtConcurrent::run([filePath]() { return loadContent(filePath); });
+}
+
+} // namespace
+
+ImagePresenter::ImagePresenter(const PresenterOptions &options)
+    : QMainWindow(), options(options) {
   setupUi();
+  StartupTrace::mark("setupUi");
   setupVariables();
+  StartupTrace::mark("setupVariables");
   setupConnections();
+  StartupTrace::mark("setupConnections");
   updateWindowTitle();
 
   show();
+  StartupTrace::mark("show");
   loadLastState();
 }
 
@@ -34,7 +67,7 @@ void ImagePresenter::setupUi() {
   setCentralWidget(centralWidget);
   layout = new QVBoxLayout(centralWidget);
 
-  topBar = new QWidget();
+  topBar = new QWidget(centralWidget);
   topLayout = new QVBoxLayout(topBar);
   controlsLayout = new QHBoxLayout();
   topLayout->addLayout(controlsLayout);
@@ -54,18 +87,29 @@ void ImagePresenter::setupUi() {
 
   instructionsLabel =
       new QLabel("S: Set point | Enter/N: Next point | Backspace/P: Previous "
-                 "point | R: Reset view | F: Toggle fullscreen | Mouse wheel: "
-                 "Scroll | Ctrl + Mouse wheel: Zoom | Mouse drag: Pan",
+                 "point | R: Reset view | F: Toggle fullscreen | D: "
+                 "Diagnostics | Mouse wheel: Scroll | Ctrl + Mouse wheel: Zoom "
+                 "| Mouse drag: Pan",
                  this);
   topLayout->addWidget(instructionsLabel, 0, Qt::AlignCenter);
 
-  layout->addWidget(topBar);
-
   graphicsView = new CustomGraphicsView(this);
   scene = new QGraphicsScene(this);
   graphicsView->setScene(scene);
   layout->addWidget(graphicsView);
 
+  // The top bar floats over the view instead of taking part in the layout,
+  // so hiding and showing it never resizes the view
+  topBar->setAutoFillBackground(true);
+  topBar->raise();
+  positionTopBar();
+
+  // Render policy diagnostics, toggled with D
+  diagnosticsLabel = new QLabel(centralWidget);
+  diagnosticsLabel->setAutoFillBackground(true);
+  diagnosticsLabel->setMargin(8);
+  diagnosticsLabel->hide();
+
   statusBar = new QStatusBar(this);
   setStatusBar(statusBar);
 
@@ -75,17 +119,52 @@ void ImagePresenter::setupUi() {
 
 void ImagePresenter::setupVariables() {
   imageItem = nullptr;
+  tiledItem = nullptr;
   svgItem = nullptr;
+  placeholderItem = nullptr;
+  loadGeneration = 0;
+  pendingLoads = 0;
+  restoreGeneration = -1;
+  restorePending = false;
+  firstFramePainted = false;
+  startupFinished = false;
   currentPointIndex = -1;
   lastAccessedFolder = "";
   currentFilePath = "";
 
-  animation = new QPropertyAnimation(this, "");
-  animation->setDuration(500);
-  animation->setEasingCurve(QEasingCurve::InOutCubic);
+  graphicsView->setSmoothZoom(
+      StateStore::instance().setting(settings::smoothZoom));
+  graphicsView->setRenderMode(options.renderMode);
+
+  renderPolicy = new RenderPolicy(graphicsView, this);
+
+  navigator = new NavigationAnimator(graphicsView, this);
+  navigator->setDuration(500);
+  navigator->setEasingCurve(QEasingCurve::InOutCubic);
 
   hideTimer = new QTimer(this);
   hideTimer->setSingleShot(true);
+
+  // Zero-interval timer: whenever the event loop has nothing else to do,
+  // the next tile, snapshot or preload is handed to the thread pool
+  idleTimer = new QTimer(this);
+  idleTimer->setInterval(0);
+  prefetchWatcher = new QFutureWatcher<void>(this);
+  snapshotWatcher = new QFutureWatcher<QImage>(this);
+
+  snapshots = std::make_unique<SnapshotCache>(qMin(
+      utils::image_memory_budget_bytes() / 4, kMaxSnapshotBytes));
+
+  // Decodes whose header gives no size stop at the memory budget. The
+  // limit is process-wide, so it is set here once rather than by each load
+  // on its worker thread.
+  QImageReader::setAllocationLimit(static_cast<int>(qBound<qint64>(
+      1, utils::image_memory_budget_bytes() >> 20, INT_MAX)));
+
+  preloader = new RecentPreloader(this);
+  preloader->setBudget(static_cast<qint64>(std::min<std::uint64_t>(
+      StateStore::instance().setting(settings::preloadMb) << 20,
+      utils::image_memory_budget_bytes() / 4)));
 }
 
 void ImagePresenter::setupConnections() {
@@ -101,51 +180,52 @@ void ImagePresenter::setupConnections() {
           &ImagePresenter::onMouseMove);
   connect(hideTimer, &QTimer::timeout, this,
           &ImagePresenter::hideTopBarAndCursor);
-}
-
-QString ImagePresenter::transformNestedSvg(const QString &svgContent) {
-  QDomDocument doc;
-  if (!doc.setContent(svgContent)) {
-    return svgContent; // Return original if parsing fails
-  }
-
-  QDomElement root = doc.documentElement();
-  if (root.tagName().toLower() != "svg") {
-    return svgContent;
-  }
-
-  // Find all svg elements
-  QDomNodeList svgNodes = root.elementsByTagName("svg");
-
-  printf("SVG nodes: %d\n", svgNodes.length());
-
-  // If we have exactly 2 SVG elements (root + one nested)
-  if (svgNodes.length() == 1) {
-    // The second node is our nested svg
-    QDomElement nestedSvg = svgNodes.at(0).toElement();
-
-    // Create new g element
-    QDomElement gElement = doc.createElement("g");
-
-    // Copy all attributes from svg to g
-    QDomNamedNodeMap attrs = nestedSvg.attributes();
-    for (int i = 0; i < attrs.length(); i++) {
-      QDomAttr attr = attrs.item(i).toAttr();
-      gElement.setAttribute(attr.name(), attr.value());
-    }
-
-    // Move all children from nested svg to g
-    while (!nestedSvg.firstChild().isNull()) {
-      gElement.appendChild(nestedSvg.firstChild());
+  connect(navigator, &NavigationAnimator::finished, this,
+          &ImagePresenter::onNavigationFinished);
+  connect(graphicsView, &CustomGraphicsView::zoomGestureFinished, this,
+          [](int wheelEvents, int repaints) {
+            qInfo() << "Zoom gesture:" << wheelEvents << "wheel events,"
+                    << repaints << "repaints";
+            utils::log_session(LogLevel::Debug,
+                               "Zoom gesture: " +
+                                   std::to_string(wheelEvents) + " events, " +
+                                   std::to_string(repaints) + " repaints");
+          });
+  connect(graphicsView, &CustomGraphicsView::frameRendered, this, [this]() {
+    if (!firstFramePainted) {
+      firstFramePainted = true;
+      StartupTrace::mark("first paint");
+      if (restorePending) {
+        // Queued: the first frame is still being painted
+        QTimer::singleShot(0, this, &ImagePresenter::restoreLastFile);
+      }
+      finishStartup();
     }
-
-    // Replace nested svg with g
-    nestedSvg.parentNode().replaceChild(gElement, nestedSvg);
-
-    return doc.toString();
-  }
-
-  return svgContent;
+  });
+  connect(renderPolicy, &RenderPolicy::decisionChanged, this,
+          [this](const RenderPolicy::Decision &decision) {
+            diagnosticsLabel->setText(decision.summary());
+            positionDiagnostics();
+            if (decision.paintMs >= 0) {
+              qInfo() << "Render policy:" << decision.summary();
+            }
+          });
+  connect(idleTimer, &QTimer::timeout, this,
+          &ImagePresenter::idleStep);
+  connect(prefetchWatcher, &QFutureWatcher<void>::finished, this,
+          &ImagePresenter::resumeIdleWork);
+  connect(snapshotWatcher, &QFutureWatcher<QImage>::finished, this,
+          &ImagePresenter::finishSnapshot);
+  connect(preloader, &RecentPreloader::loadFinished, this,
+          &ImagePresenter::resumeIdleWork);
+  connect(graphicsView, &CustomGraphicsView::renderQualityChanged, this,
+          [this](CustomGraphicsView::RenderQuality quality) {
+            // Idle work waits while the view is moving
+            if (quality == CustomGraphicsView::RenderQuality::Full &&
+                hasContent()) {
+              idleTimer->start();
+            }
+          });
 }
 
 void ImagePresenter::toggleFullscreen() {
@@ -160,19 +240,61 @@ void ImagePresenter::toggleFullscreen() {
 
 void ImagePresenter::loadLastState() {
   auto [lastOpenedFile, lastFolder, recentFilesList] = utils::load_state();
+  StartupTrace::mark("load_state");
   lastAccessedFolder = QString::fromStdString(lastFolder);
   recentFiles = utils::stdVectorToQStringList(recentFilesList);
   updateRecentFilesDropdown();
 
-  if (!lastOpenedFile.empty()) {
-    QString filePath = QString::fromStdString(lastOpenedFile);
-    if (QFile::exists(filePath)) {
-      loadFile(filePath);
-      utils::log_session("Loaded last opened file: " + lastOpenedFile);
-    }
+  QString filePath = options.initialFile;
+  if (filePath.isEmpty() && options.restoreLastFile) {
+    filePath = QString::fromStdString(lastOpenedFile);
+  }
+  if (!filePath.isEmpty() && QFile::exists(filePath)) {
+    // Started once the empty window has painted its first frame, and
+    // decoded off the GUI thread, so a large last file never delays it
+    restorePending = true;
+    restoreFilePath = filePath;
+  }
+}
+
+void ImagePresenter::restoreLastFile() {
+  if (currentFilePath.isEmpty() && !placeholderItem) {
+    loadFileAsync(restoreFilePath);
+    restoreGeneration = loadGeneration;
+    utils::log_session("Restoring last opened file: " +
+                       restoreFilePath.toStdString());
+  } else {
+    restorePending = false;
+    finishStartup();
   }
 }
 
+void ImagePresenter::finishStartup() {
+  if (startupFinished || !firstFramePainted || restorePending) {
+    return;
+  }
+  startupFinished = true;
+  StartupTrace::mark("startup complete");
+
+  SessionEvent event;
+  event.type = "startup";
+  event.ms = StartupTrace::elapsedMs("startup complete");
+  event.values = {{"first_paint_ms", StartupTrace::elapsedMs("first paint")}};
+  utils::log_event(std::move(event));
+
+  emit startupComplete();
+}
+
+void ImagePresenter::openForwardedFile(const QString &filePath) {
+  loadFileAsync(filePath);
+  utils::log_session("Opening forwarded file: " + filePath.toStdString());
+  if (isMinimized()) {
+    showNormal();
+  }
+  raise();
+  activateWindow();
+}
+
 void ImagePresenter::updateWindowTitle() {
   if (!currentFilePath.isEmpty()) {
     QString fileName = QFileInfo(currentFilePath).fileName();
@@ -193,7 +315,7 @@ void ImagePresenter::updateRecentFilesDropdown() {
 void ImagePresenter::loadRecentFile(int index) {
   if (index > 0) {
     QString filePath = recentFilesDropdown->itemData(index).toString();
-    loadFile(filePath);
+    loadFileAsync(filePath);
     recentFilesDropdown->setCurrentIndex(0);
   }
 }
@@ -207,9 +329,34 @@ void ImagePresenter::addToRecentFiles(const QString &filePath) {
   updateRecentFilesDropdown();
 }
 
-void ImagePresenter::startHideTimer() { hideTimer->start(5000); }
+void ImagePresenter::positionTopBar() {
+  topBar->setGeometry(0, 0, centralWidget->width(),
+                      topBar->sizeHint().height());
+}
+
+void ImagePresenter::positionDiagnostics() {
+  diagnosticsLabel->adjustSize();
+  diagnosticsLabel->move(0, centralWidget->height() -
+                                diagnosticsLabel->height());
+}
+
+void ImagePresenter::toggleDiagnostics() {
+  diagnosticsLabel->setVisible(diagnosticsLabel->isHidden());
+  diagnosticsLabel->raise();
+  positionDiagnostics();
+}
+
+void ImagePresenter::startHideTimer() { hideTimer->start(kHideDelay); }
 
 void ImagePresenter::hideTopBarAndCursor() {
+  // The timer is not restarted on every mouse move; if the mouse moved
+  // since it was started, wait for the rest of the delay
+  const qint64 sinceMove =
+      lastMouseMove.isValid() ? lastMouseMove.elapsed() : kHideDelay;
+  if (sinceMove < kHideDelay) {
+    hideTimer->start(static_cast<int>(kHideDelay - sinceMove));
+    return;
+  }
   topBar->hide();
   QApplication::setOverrideCursor(Qt::BlankCursor);
   graphicsView->viewport()->setCursor(Qt::BlankCursor);
@@ -222,8 +369,13 @@ void ImagePresenter::showTopBarAndCursor() {
 }
 
 void ImagePresenter::onMouseMove() {
-  showTopBarAndCursor();
-  startHideTimer();
+  lastMouseMove.start();
+  if (topBar->isHidden()) {
+    showTopBarAndCursor();
+    startHideTimer();
+  } else if (!hideTimer->isActive()) {
+    startHideTimer();
+  }
 }
 
 void ImagePresenter::toggleHiding(bool enable) {
@@ -258,145 +410,205 @@ void ImagePresenter::loadImage() {
     QList<QUrl> urls = dialog.selectedUrls();
     if (!urls.isEmpty()) {
       QString filePath = urls[0].toLocalFile();
-      loadFile(filePath);
+      loadFileAsync(filePath);
     }
   }
 }
 
-void ImagePresenter::loadFile(const QString &filePath) {
-  lastAccessedFolder = QFileInfo(filePath).path();
+void ImagePresenter::clearContent() {
+  // Any load still running is superseded
+  ++loadGeneration;
+  graphicsView->setRenderSource(nullptr);
+  renderSource.reset();
+  renderPolicy->setContent(nullptr, RenderPolicy::Content::None);
   scene->clear();
+  snapshots->clear();
+  graphicsView->clearSnapshot();
   imageItem = nullptr;
+  tiledItem = nullptr;
   svgItem = nullptr;
-  try {
-    if (filePath.toLower().endsWith(".neatp")) {
-      loadPresentation(filePath);
-    } else if (filePath.toLower().endsWith(".svg")) {
-      loadSvgFile(filePath);
-    } else {
-      loadImageFile(filePath);
-    }
+  placeholderItem = nullptr;
+  svgRenderer.reset();
+  presentationPoints.clear();
+  currentPointIndex = -1;
+}
 
-    graphicsView->setInitialZoom();
-    updateStatusBar();
-    qInfo() << "Image/Presentation loaded:" << filePath;
-    addToRecentFiles(filePath);
-    utils::save_state(filePath.toStdString(), lastAccessedFolder.toStdString(),
-                      utils::QStringListToStdVector(recentFiles));
-    utils::log_session("Loaded file: " + filePath.toStdString());
-    currentFilePath = filePath;
-    updateWindowTitle();
-  } catch (const std::exception &e) {
-    qCritical() << "Error loading image/presentation:" << e.what();
-    utils::log_session("Error loading file: " + filePath.toStdString() +
-                       ", Error: " + e.what());
-  }
+void ImagePresenter::loadFile(const QString &filePath) {
+  loadTimer.start();
+  clearContent();
+  showContent(loadContent(filePath));
 }
 
-void ImagePresenter::loadImageFile(const QString &filePath) {
-  QImageReader reader(filePath);
-  QImage image = reader.read();
-  if (image.isNull()) {
-    throw std::runtime_error("Failed to load image: " + filePath.toStdString());
+void ImagePresenter::loadFileAsync(const QString &filePath) {
+  loadTimer.start();
+  clearContent();
+
+  // Decoded ahead of time while idle
+  LoadedContent preloaded;
+  if (preloader->take(filePath, preloaded)) {
+    showContent(std::move(preloaded));
+    return;
   }
-  QPixmap pixmap = QPixmap::fromImage(image);
-  imageItem = scene->addPixmap(pixmap);
-  scene->setSceneRect(pixmap.rect());
-  imageFormat = reader.format();
-  presentationPoints.clear();
-  currentPointIndex = -1;
-  graphicsView->setOriginalImageSize(pixmap.size());
-}
-
-void ImagePresenter::loadSvgFile(const QString &filePath) {
-  QFile file(filePath);
-  if (!file.open(QIODevice::ReadOnly)) {
-    throw std::runtime_error("Failed to open SVG file: " +
-                             filePath.toStdString());
-  }
-
-  QString content = QString::fromUtf8(file.readAll());
-  file.close();
-
-  // Transform nested SVG if needed
-  svgContent = transformNestedSvg(content);
-
-  // Create a temporary file for the transformed content
-  QTemporaryFile tempFile;
-  if (tempFile.open()) {
-    QTextStream stream(&tempFile);
-    stream << svgContent;
-    tempFile.close();
-
-    svgItem = new QGraphicsSvgItem(tempFile.fileName());
-    if (svgItem->renderer()->isValid()) {
-      scene->addItem(svgItem);
-      QRectF bounds = svgItem->boundingRect();
-      scene->setSceneRect(bounds);
-      imageFormat = "svg";
-      presentationPoints.clear();
-      currentPointIndex = -1;
-      graphicsView->setOriginalImageSize(bounds.size().toSize());
-    } else {
-      delete svgItem;
-      svgItem = nullptr;
-      throw std::runtime_error("Failed to load SVG file: " +
-                               filePath.toStdString());
-    }
+
+  // Stand-in until the worker is done, so the window paints straight away
+  placeholderItem =
+      scene->addSimpleText(QString("Loading %1...")
+                               .arg(QFileInfo(filePath).fileName()));
+  placeholderItem->setBrush(palette().color(QPalette::WindowText));
+  scene->setSceneRect(placeholderItem->boundingRect());
+  graphicsView->setViewState(placeholderItem->boundingRect().center(), 1.0);
+  statusBar->showMessage(QString("Loading %1...").arg(filePath));
+
+  // A file being preloaded right now is not decoded a second time; any
+  // other preload makes way for this load
+  QFuture<LoadedContent> preloading = preloader->adopt(filePath);
+  if (preloading.isValid()) {
+    watchLoad(filePath, preloading, true);
   } else {
-    throw std::runtime_error(
-        "Failed to create temporary file for SVG transformation");
+    preloader->cancel();
+    watchLoad(filePath, startLoad(filePath), false);
   }
 }
 
-void ImagePresenter::loadPresentation(const QString &filePath) {
-  QFile file(filePath);
-  if (!file.open(QIODevice::ReadOnly)) {
-    throw std::runtime_error("Failed to open presentation file: " +
-                             filePath.toStdString());
+void ImagePresenter::watchLoad(const QString &filePath,
+                               const QFuture<LoadedContent> &future,
+                               bool preloaded) {
+  const int generation = loadGeneration;
+  auto *watcher = new QFutureWatcher<LoadedContent>(this);
+  connect(watcher, &QFutureWatcher<LoadedContent>::finished, this,
+          [this, watcher, generation, filePath, preloaded]() {
+            watcher->deleteLater();
+            --pendingLoads;
+            // Dropped if another file was opened meanwhile
+            if (generation == loadGeneration) {
+              LoadedContent content = watcher->future().result();
+              if (preloaded && !content.ok()) {
+                // The preload may only have hit its share of the memory
+                // budget, which a load of the user's does not have
+                watchLoad(filePath, startLoad(filePath), false);
+                return;
+              }
+              clearContent();
+              showContent(std::move(content));
+            } else {
+              // Preloads held back for it can go on
+              resumeIdleWork();
+            }
+            if (restorePending && generation == restoreGeneration) {
+              restorePending = false;
+              StartupTrace::mark("restore last file");
+              finishStartup();
+            }
+          });
+  ++pendingLoads;
+  watcher->setFuture(future);
+}
+
+void ImagePresenter::showContent(LoadedContent content) {
+  const QString &filePath = content.filePath;
+  if (!content.ok()) {
+    qCritical() << "Error loading image/presentation:" << content.error;
+    statusBar->showMessage(QString("Error: %1").arg(content.error));
+    utils::log_session(LogLevel::Error,
+                       "Error loading file: " + filePath.toStdString() +
+                           ", Error: " + content.error.toStdString());
+    SessionEvent event;
+    event.type = "load_error";
+    event.file = filePath.toStdString();
+    event.ms = loadTimer.nsecsElapsed() / 1e6;
+    event.error = content.error.toStdString();
+    utils::log_event(std::move(event));
+    return;
   }
 
-  QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
-  QJsonObject data = doc.object();
+  lastAccessedFolder = QFileInfo(filePath).path();
+  imageFormat = content.imageFormat;
+  switch (content.kind) {
+  case LoadedContent::Kind::Tiled:
+    tiledItem = content.pyramid ? new TiledImageItem(content.pyramid)
+                                : new TiledImageItem(content.decoder);
+    tiledItem->setCacheLimit(content.tileCacheBytes);
+    scene->addItem(tiledItem);
+    break;
+  case LoadedContent::Kind::Raster:
+    // Moving the image lets the pixmap adopt its buffer
+    imageItem = scene->addPixmap(QPixmap::fromImage(std::move(content.image)));
+    break;
+  case LoadedContent::Kind::Svg:
+    svgContent = content.svgContent;
+    svgRenderer = content.svgRenderer;
+    svgItem = new QGraphicsSvgItem();
+    svgItem->setSharedRenderer(svgRenderer.get());
+    scene->addItem(svgItem);
+    break;
+  }
+  presentationPoints = content.points;
+  currentPointIndex = -1;
 
-  bool isSvg = data["is_svg"].toBool();
-  QByteArray imageData =
-      QByteArray::fromBase64(data["image_data"].toString().toUtf8());
-  imageFormat = data["image_format"].toString();
+  QRectF bounds = scene->itemsBoundingRect();
+  scene->setSceneRect(bounds);
+  graphicsView->setOriginalImageSize(bounds.size().toSize());
 
-  if (isSvg) {
-    QTemporaryFile tempFile;
-    if (tempFile.open()) {
-      tempFile.write(imageData);
-      tempFile.close();
-      loadSvgFile(tempFile.fileName());
-    } else {
-      throw std::runtime_error("Failed to create temporary file for SVG data");
-    }
-  } else {
-    QPixmap pixmap;
-    if (!pixmap.loadFromData(imageData, imageFormat.toUtf8().constData())) {
-      throw std::runtime_error(
-          "Failed to load image data from presentation file");
-    }
-    imageItem = scene->addPixmap(pixmap);
-    scene->setSceneRect(pixmap.rect());
-    graphicsView->setOriginalImageSize(pixmap.size());
+  updateRenderSource();
+  updateRenderPolicy();
+  graphicsView->setInitialZoom();
+  statusBar->clearMessage();
+  updateStatusBar();
+  schedulePrefetch();
+  qInfo() << "Image/Presentation loaded:" << filePath;
+  addToRecentFiles(filePath);
+  QStringList otherRecentFiles = recentFiles;
+  otherRecentFiles.removeAll(filePath);
+  preloader->setCandidates(otherRecentFiles);
+  // Preloading runs from the idle loop even without presentation points
+  idleTimer->start();
+  utils::save_state(filePath.toStdString(), lastAccessedFolder.toStdString(),
+                    utils::QStringListToStdVector(recentFiles));
+  utils::log_session("Loaded file: " + filePath.toStdString());
+  currentFilePath = filePath;
+  updateWindowTitle();
+
+  // Request to first frame on screen, decode included
+  SessionEvent event;
+  event.type = "load";
+  event.file = filePath.toStdString();
+  event.ms = loadTimer.nsecsElapsed() / 1e6;
+  event.bytes = QFileInfo(filePath).size();
+  event.values = {{"decode_ms", content.decodeMs},
+                  {"width", bounds.width()},
+                  {"height", bounds.height()},
+                  {"points", double(presentationPoints.size())}};
+  utils::log_event(std::move(event));
+}
+
+void ImagePresenter::updateRenderPolicy() {
+  if (tiledItem) {
+    renderPolicy->setContent(tiledItem, RenderPolicy::Content::TiledRaster);
+  } else if (imageItem) {
+    renderPolicy->setContent(imageItem, RenderPolicy::Content::Raster);
+  } else if (svgItem) {
+    renderPolicy->setContent(svgItem, RenderPolicy::Content::Vector);
   }
+}
 
-  presentationPoints.clear();
-  QJsonArray points = data["presentation_points"].toArray();
-  for (const auto &pointJson : points) {
-    QJsonObject pointObj = pointJson.toObject();
-    QPointF point(pointObj["x"].toDouble(), pointObj["y"].toDouble());
-    qreal zoom = pointObj["zoom"].toDouble();
-    presentationPoints.emplace_back(point, zoom);
+void ImagePresenter::updateRenderSource() {
+  // The sources share their data with the scene items
+  if (tiledItem) {
+    renderSource = RenderSource::fromPyramid(tiledItem->pyramid());
+  } else if (imageItem) {
+    renderSource = RenderSource::fromImage(imageItem->pixmap().toImage());
+  } else if (svgItem) {
+    renderSource = RenderSource::fromSvg(svgContent.toUtf8());
+  }
+  // Snapshots always render from the source; the view only paints from it
+  // outside direct mode
+  if (graphicsView->renderMode() != CustomGraphicsView::RenderMode::Direct) {
+    graphicsView->setRenderSource(renderSource);
   }
-  currentPointIndex = -1;
 }
 
 void ImagePresenter::savePresentation() {
-  if (!imageItem && !svgItem) {
+  if (!hasContent()) {
     qWarning() << "No image loaded to save";
     return;
   }
@@ -425,6 +637,8 @@ void ImagePresenter::savePresentation() {
     filePath += ".neatp";
   }
 
+  QElapsedTimer timer;
+  timer.start();
   try {
     QByteArray imageData = encodeImageData();
     QJsonObject data;
@@ -457,10 +671,19 @@ void ImagePresenter::savePresentation() {
     utils::log_session("Saved presentation: " + filePath.toStdString());
     currentFilePath = filePath;
     updateWindowTitle();
+
+    SessionEvent event;
+    event.type = "save";
+    event.file = filePath.toStdString();
+    event.ms = timer.nsecsElapsed() / 1e6;
+    event.bytes = file.size();
+    event.values = {{"points", double(presentationPoints.size())}};
+    utils::log_event(std::move(event));
   } catch (const std::exception &e) {
     qCritical() << "Error saving presentation:" << e.what();
-    utils::log_session("Error saving presentation: " + filePath.toStdString() +
-                       ", Error: " + e.what());
+    utils::log_session(LogLevel::Error,
+                       "Error saving presentation: " +
+                           filePath.toStdString() + ", Error: " + e.what());
   }
 }
 
@@ -472,6 +695,9 @@ QByteArray ImagePresenter::encodeImageData() {
   if (svgItem) {
     // Simply write the stored SVG content
     buffer.write(svgContent.toUtf8());
+  } else if (tiledItem) {
+    // Never decoded in full; the original bytes are already in imageFormat
+    buffer.write(tiledItem->decoder().encodedData());
   } else if (imageItem) {
     imageItem->pixmap().save(&buffer, imageFormat.toUtf8().constData());
   }
@@ -479,6 +705,10 @@ QByteArray ImagePresenter::encodeImageData() {
   return imageData;
 }
 
+bool ImagePresenter::hasContent() const {
+  return imageItem || tiledItem || svgItem;
+}
+
 void ImagePresenter::keyPressEvent(QKeyEvent *event) {
   switch (event->key()) {
   case Qt::Key_S:
@@ -499,6 +729,9 @@ void ImagePresenter::keyPressEvent(QKeyEvent *event) {
   case Qt::Key_F:
     toggleFullscreen();
     break;
+  case Qt::Key_D:
+    toggleDiagnostics();
+    break;
   case Qt::Key_Escape:
     if (isFullScreen()) {
       showNormal();
@@ -516,14 +749,21 @@ void ImagePresenter::mouseMoveEvent(QMouseEvent *event) {
   onMouseMove();
 }
 
+void ImagePresenter::resizeEvent(QResizeEvent *event) {
+  QMainWindow::resizeEvent(event);
+  positionTopBar();
+  positionDiagnostics();
+}
+
 void ImagePresenter::setPresenterPoint() {
-  if (imageItem || svgItem) {
+  if (hasContent()) {
     QPointF center =
         graphicsView->mapToScene(graphicsView->viewport()->rect().center());
     qreal zoom = graphicsView->getZoom();
     presentationPoints.emplace_back(center, zoom);
     currentPointIndex = static_cast<int>(presentationPoints.size()) - 1;
     updateStatusBar();
+    schedulePrefetch();
     qInfo() << "Presentation point set:" << center << "zoom:" << zoom;
     utils::log_session("Set presentation point: " +
                        std::to_string(presentationPoints.size()));
@@ -535,8 +775,8 @@ void ImagePresenter::nextPoint() { navigateToNextPoint(1); }
 void ImagePresenter::previousPoint() { navigateToNextPoint(-1); }
 
 void ImagePresenter::resetView() {
-  if (imageItem || svgItem) {
-    graphicsView->fitInView(scene->sceneRect(), Qt::KeepAspectRatio);
+  if (hasContent()) {
+    graphicsView->setInitialZoom();
     updateStatusBar();
     qInfo() << "View reset";
     utils::log_session("View reset");
@@ -544,7 +784,7 @@ void ImagePresenter::resetView() {
 }
 
 void ImagePresenter::updateStatusBar() {
-  if (imageItem || svgItem) {
+  if (hasContent()) {
     QString status =
         QString("Points: %1 | Current: %2")
             .arg(presentationPoints.size())
@@ -567,32 +807,196 @@ void ImagePresenter::navigateToPoint(const std::tuple<QPointF, qreal> &point) {
 void ImagePresenter::smoothNavigateToPoint(const QPointF &startCenter,
                                            const QPointF &endCenter,
                                            qreal startZoom, qreal endZoom) {
-  delete animation;
-  animation = new QPropertyAnimation(this, "");
-  animation->setDuration(500);
-  animation->setEasingCurve(QEasingCurve::InOutCubic);
-
-  connect(
-      animation, &QPropertyAnimation::valueChanged, this,
-      [=](const QVariant &value) {
-        qreal t = value.toReal();
-
-        // Apply zoom and position changes together
-        graphicsView->setTransformationAnchor(QGraphicsView::AnchorViewCenter);
-
-        // Calculate the current zoom and position
-        qreal currentZoom = (1 - t) * startZoom + t * endZoom;
-        QPointF currentCenter((1 - t) * startCenter.x() + t * endCenter.x(),
-                              (1 - t) * startCenter.y() + t * endCenter.y());
-
-        // Set zoom and center in a single transform update
-        graphicsView->setZoom(currentZoom);
-        graphicsView->centerOn(currentCenter);
-      });
-
-  animation->setStartValue(0.0);
-  animation->setEndValue(1.0);
-  animation->start();
+  navigator->start(startCenter, startZoom, endCenter, endZoom);
+}
+
+void ImagePresenter::onNavigationFinished(
+    const NavigationAnimator::FrameStats &stats) {
+  qInfo() << "Navigation:" << stats.summary();
+  utils::log_session("Navigation frames: " + stats.summary().toStdString());
+
+  SessionEvent event;
+  event.type = "navigation";
+  event.file = currentFilePath.toStdString();
+  event.ms = stats.durationMs;
+  event.values = {{"frames", double(stats.frames)},
+                  {"missed_frames", double(stats.missedFrames)},
+                  {"refresh_hz", stats.refreshRate},
+                  {"avg_render_ms", stats.averageRenderMs},
+                  {"max_render_ms", stats.maxRenderMs}};
+  utils::log_event(std::move(event));
+
+  // Land on the prerendered frame; the settle pass repaints from the scene
+  if (currentPointIndex >= 0) {
+    snapshots->setViewport(graphicsView->viewport()->size(),
+                           graphicsView->viewport()->devicePixelRatioF());
+    if (const SnapshotCache::Snapshot *snapshot =
+            snapshots->snapshot(currentPointIndex)) {
+      graphicsView->showSnapshot(snapshot->pixmap, snapshot->sceneRect);
+    }
+  }
+  schedulePrefetch();
+}
+
+void ImagePresenter::schedulePrefetch() {
+  if (presentationPoints.empty()) {
+    return;
+  }
+  if (!tiledItem) {
+    idleTimer->start();
+    return;
+  }
+
+  // Only the neighbours of the current point are worth having; anything
+  // queued for an earlier position is stale
+  tiledItem->clearPrefetch();
+
+  const QSizeF viewSize = graphicsView->viewport()->size();
+  const qreal dpr = graphicsView->viewport()->devicePixelRatioF();
+  const auto prefetchView = [&](const QPointF &center, qreal zoom,
+                                bool draft) {
+    if (zoom <= 0) {
+      return;
+    }
+    const QSizeF sceneSize = viewSize / zoom;
+    const QRectF region(center - QPointF(sceneSize.width() / 2,
+                                         sceneSize.height() / 2),
+                        sceneSize);
+    tiledItem->prefetch(tiledItem->mapRectFromScene(region), zoom * dpr,
+                        draft);
+  };
+
+  const QPointF here =
+      graphicsView->mapToScene(graphicsView->viewport()->rect().center());
+  const qreal hereZoom = graphicsView->getZoom();
+
+  const int numPoints = static_cast<int>(presentationPoints.size());
+  const int next =
+      currentPointIndex < 0 ? 0 : (currentPointIndex + 1) % numPoints;
+  const int previous = currentPointIndex < 0
+                           ? numPoints - 1
+                           : (currentPointIndex - 1 + numPoints) % numPoints;
+
+  // Landing views first, next before previous, then the draft-quality tiles
+  // along each path
+  std::vector<int> neighbours{next};
+  if (previous != next) {
+    neighbours.push_back(previous);
+  }
+  for (int index : neighbours) {
+    const auto &[center, zoom] = presentationPoints[index];
+    prefetchView(center, zoom, false);
+  }
+  for (int index : neighbours) {
+    const auto &[center, zoom] = presentationPoints[index];
+    for (int step = 1; step <= kPrefetchPathSteps; ++step) {
+      const qreal t = qreal(step) / (kPrefetchPathSteps + 1);
+      prefetchView(here + (center - here) * t,
+                   (1 - t) * hereZoom + t * zoom, true);
+    }
+  }
+
+  idleTimer->start();
+}
+
+void ImagePresenter::idleStep() {
+  // Each step hands one job to the thread pool; the job's watcher resumes
+  // the loop once it is done
+  idleTimer->stop();
+  if (!hasContent() || graphicsView->renderQuality() !=
+                           CustomGraphicsView::RenderQuality::Full) {
+    return;
+  }
+  if (prefetchWatcher->isRunning() || snapshotWatcher->isRunning()) {
+    return;
+  }
+  // Neighbouring tiles first: they also speed up the snapshot renders.
+  // Other files come last, after the current one is fully prepared, and
+  // wait for the user's own loads, which they would compete with for
+  // memory and cores.
+  if (tiledItem && tiledItem->hasPendingPrefetch()) {
+    prefetchWatcher->setFuture(tiledItem->prefetchNext());
+  } else if (!startNextSnapshot() && pendingLoads == 0) {
+    preloader->setViewport(graphicsView->viewport()->size(),
+                           graphicsView->viewport()->devicePixelRatioF());
+    preloader->preloadNext();
+  }
+}
+
+void ImagePresenter::resumeIdleWork() {
+  if (hasContent() && graphicsView->renderQuality() ==
+                          CustomGraphicsView::RenderQuality::Full) {
+    idleTimer->start();
+  }
+}
+
+std::vector<int> ImagePresenter::snapshotOrder() const {
+  // Points in the order they are likely to be visited: next, previous,
+  // then alternating outwards
+  const int numPoints = static_cast<int>(presentationPoints.size());
+  std::vector<int> order;
+  const auto add = [&](int index) {
+    const int wrapped = ((index % numPoints) + numPoints) % numPoints;
+    if (std::find(order.begin(), order.end(), wrapped) == order.end()) {
+      order.push_back(wrapped);
+    }
+  };
+
+  if (currentPointIndex < 0) {
+    for (int distance = 0; distance < numPoints; ++distance) {
+      add(distance);
+      add(numPoints - 1 - distance);
+    }
+  } else {
+    for (int distance = 1; distance <= numPoints; ++distance) {
+      add(currentPointIndex + distance);
+      add(currentPointIndex - distance);
+    }
+  }
+  return order;
+}
+
+bool ImagePresenter::startNextSnapshot() {
+  if (presentationPoints.empty() || !renderSource ||
+      !graphicsView->isVisible()) {
+    return false;
+  }
+
+  const QSize viewSize = graphicsView->viewport()->size();
+  const qreal dpr = graphicsView->viewport()->devicePixelRatioF();
+  snapshots->setViewport(viewSize, dpr);
+
+  for (int index : snapshotOrder()) {
+    if (snapshots->contains(index)) {
+      continue;
+    }
+    // Stop rather than evict snapshots of closer points
+    if (!snapshots->hasRoomForAnother()) {
+      return false;
+    }
+    const auto &[center, zoom] = presentationPoints[index];
+    const QRectF sceneRect = graphicsView->sceneRectFor(center, zoom);
+    snapshotJob = {index, sceneRect, viewSize, dpr, loadGeneration};
+    snapshotWatcher->setFuture(
+        QtConcurrent::run(&CustomGraphicsView::renderSnapshot,
+                          graphicsView->snapshotRequest(renderSource,
+                                                        sceneRect)));
+    return true;
+  }
+  return false;
+}
+
+void ImagePresenter::finishSnapshot() {
+  QImage image = snapshotWatcher->result();
+  // Dropped if the content was replaced while it rendered
+  if (snapshotJob.loadGeneration == loadGeneration && !image.isNull()) {
+    snapshots->setViewport(snapshotJob.viewportSize,
+                           snapshotJob.devicePixelRatio);
+    snapshots->insert(snapshotJob.index,
+                      {QPixmap::fromImage(std::move(image)),
+                       snapshotJob.sceneRect});
+  }
+  resumeIdleWork();
 }
 
 void ImagePresenter::navigateToNextPoint(int direction) {
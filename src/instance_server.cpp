@@ -0,0 +1,90 @@
+#include "instance_server.h"
+#include <QLocalServer>
+#include <QLocalSocket>
+
+namespace {
+
+// A running instance answers within a few milliseconds; anything slower is
+// a stale socket
+constexpr int kConnectTimeout = 200;
+constexpr int kWriteTimeout = 1000;
+
+// One server per user, so users sharing a machine never open files in each
+// other's windows
+QString serverName() {
+  const QString runtimeDir = qEnvironmentVariable("XDG_RUNTIME_DIR");
+  if (!runtimeDir.isEmpty()) {
+    // Flatpak gives every instance its own /tmp; the app's runtime
+    // directory is the one place all of them share
+    const QString flatpakId = qEnvironmentVariable("FLATPAK_ID");
+    if (!flatpakId.isEmpty()) {
+      return runtimeDir + "/app/" + flatpakId + "/neat-instance";
+    }
+    // Only the user can create files here (mode 0700). In the shared /tmp
+    // another user could take the name first and receive every file.
+    return runtimeDir + "/neat-instance";
+  }
+
+  QString user = qEnvironmentVariable("USER");
+  if (user.isEmpty()) {
+    user = qEnvironmentVariable("USERNAME");
+  }
+  return "neat-" + user;
+}
+
+} // namespace
+
+InstanceServer::InstanceServer(QObject *parent)
+    : QObject(parent), m_server(new QLocalServer(this)) {
+  m_server->setSocketOptions(QLocalServer::UserAccessOption);
+  connect(m_server, &QLocalServer::newConnection, this,
+          &InstanceServer::acceptConnection);
+}
+
+bool InstanceServer::listen() {
+  if (m_server->listen(serverName())) {
+    return true;
+  }
+  if (m_server->serverError() != QAbstractSocket::AddressInUseError) {
+    return false;
+  }
+
+  // Only take the name over if nobody answers on it
+  QLocalSocket probe;
+  probe.connectToServer(serverName());
+  if (probe.waitForConnected(kConnectTimeout)) {
+    return false;
+  }
+  QLocalServer::removeServer(serverName());
+  return m_server->listen(serverName());
+}
+
+bool InstanceServer::forward(const QString &filePath) {
+  QLocalSocket socket;
+  socket.connectToServer(serverName());
+  if (!socket.waitForConnected(kConnectTimeout)) {
+    return false;
+  }
+  socket.write(filePath.toUtf8() + '\n');
+  if (!socket.waitForBytesWritten(kWriteTimeout)) {
+    return false;
+  }
+  socket.disconnectFromServer();
+  return true;
+}
+
+void InstanceServer::acceptConnection() {
+  while (QLocalSocket *socket = m_server->nextPendingConnection()) {
+    connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
+      while (socket->canReadLine()) {
+        const QString filePath =
+            QString::fromUtf8(socket->readLine()).trimmed();
+        if (!filePath.isEmpty()) {
+          emit fileRequested(filePath);
+        }
+      }
+    });
+    connect(socket, &QLocalSocket::disconnected, socket,
+            &QLocalSocket::deleteLater);
+  }
+}
@@ -1,18 +1,232 @@
 #include "image_presenter.h"
+#include "instance_server.h"
+#include "session_logger.h"
+#include "session_stats.h"
+#include "startup_trace.h"
+#include "state_store.h"
 #include "utils.h"
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+// Loads every file `iterations` times and prints, for each load, the peak
+// RSS reached while loading and painting it relative to the RSS before.
+int runLoadBenchmark(ImagePresenter &window, const QStringList &files,
+                     int iterations) {
+  std::printf("file\titeration\tms\trss_before_mb\tpeak_mb\tpeak_delta_mb\n");
+  for (const QString &file : files) {
+    for (int i = 0; i < iterations; ++i) {
+      QCoreApplication::processEvents();
+      utils::reset_peak_rss();
+      const std::uint64_t before = utils::current_rss_bytes();
+
+      QElapsedTimer timer;
+      timer.start();
+      window.loadFile(file);
+      QCoreApplication::processEvents(); // Paint the loaded image once
+      const qint64 elapsed = timer.elapsed();
+
+      const std::uint64_t peak = utils::peak_rss_bytes();
+      std::printf("%s\t%d\t%lld\t%.1f\t%.1f\t%.1f\n",
+                  qPrintable(QFileInfo(file).fileName()), i + 1,
+                  static_cast<long long>(elapsed), before / 1048576.0,
+                  peak / 1048576.0,
+                  (static_cast<double>(peak) - before) / 1048576.0);
+    }
+  }
+  return 0;
+}
+
+// The file to hand to a running instance, picked from the raw arguments
+// before QApplication exists. Empty when this launch needs a process of its
+// own: no file or more than one, or an option a running window cannot
+// honour (any option but --no-restore, which only matters at startup).
+QString forwardedFile(int argc, char *argv[]) {
+  QString file;
+  bool positionalOnly = false;
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    if (!positionalOnly && std::strcmp(arg, "--") == 0) {
+      positionalOnly = true;
+    } else if (positionalOnly || arg[0] != '-' || arg[1] == '\0') {
+      if (!file.isEmpty()) {
+        return QString();
+      }
+      file = QString::fromLocal8Bit(arg);
+    } else if (std::strcmp(arg, "--no-restore") != 0) {
+      return QString();
+    }
+  }
+  return file;
+}
+
+bool parseRenderMode(const QString &name,
+                     CustomGraphicsView::RenderMode &mode) {
+  if (name == "direct") {
+    mode = CustomGraphicsView::RenderMode::Direct;
+  } else if (name == "parallel") {
+    mode = CustomGraphicsView::RenderMode::Parallel;
+  } else if (name == "threaded") {
+    mode = CustomGraphicsView::RenderMode::Threaded;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+} // namespace
 
 int main(int argc, char *argv[]) {
+  StartupTrace::start();
   try {
+    // `neat stats` summarises the recorded session events and exits
+    if (argc >= 2 && std::strcmp(argv[1], "stats") == 0) {
+      return runSessionStats(utils::ensure_neat_directory(), std::cout);
+    }
+
+    // `neat <file>`, as run by file managers, hands the file to a running
+    // instance before paying for QApplication and the window
+    const QString forwarded = forwardedFile(argc, argv);
+    if (!forwarded.isEmpty()) {
+      QCoreApplication forwarder(argc, argv);
+      if (InstanceServer::forward(QFileInfo(forwarded).absoluteFilePath())) {
+        return 0;
+      }
+    }
+
     QApplication app(argc, argv);
+    StartupTrace::mark("QApplication");
     app.setApplicationDisplayName("Neat");
     app.setApplicationName("Neat");
     app.setApplicationVersion("0.0.1");
 
-    ImagePresenter window;
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Image presentation tool");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("file", "Image or presentation to open.",
+                                 "[file]");
+    QCommandLineOption benchmarkOption(
+        "benchmark-load",
+        "Load <file> (repeatable), print the peak RSS of each load and exit.",
+        "file");
+    QCommandLineOption iterationsOption(
+        "benchmark-iterations", "Number of loads per benchmarked file.",
+        "count", "3");
+    QCommandLineOption renderModeOption(
+        "render-mode",
+        "How frames are painted: direct (default), parallel, which splits "
+        "each frame into bands painted on all cores, or threaded, which "
+        "paints on a worker thread and keeps the GUI thread responsive.",
+        "mode", "direct");
+    QCommandLineOption noRestoreOption(
+        "no-restore", "Start with an empty window instead of reopening the "
+                      "last file.");
+    parser.addOption(benchmarkOption);
+    parser.addOption(iterationsOption);
+    parser.addOption(renderModeOption);
+    QCommandLineOption startupTraceOption(
+        "startup-trace",
+        "Print how long each startup phase took, up to the first painted "
+        "frame and the restored last file.");
+    QCommandLineOption startupBudgetOption(
+        "startup-budget",
+        "Implies --startup-trace. Exit once started, with status 2 if the "
+        "first frame took longer than <ms> to paint.",
+        "ms");
+    QCommandLineOption newInstanceOption(
+        "new-instance", "Open a window of its own, even if Neat is already "
+                        "running, and do not take files from later launches.");
+    parser.addOption(noRestoreOption);
+    parser.addOption(newInstanceOption);
+    parser.addOption(startupTraceOption);
+    parser.addOption(startupBudgetOption);
+    parser.process(app);
+    StartupTrace::mark("command line");
+
+    PresenterOptions options;
+    if (!parseRenderMode(parser.value(renderModeOption),
+                         options.renderMode)) {
+      qCritical() << "Unknown render mode:" << parser.value(renderModeOption);
+      return 1;
+    }
+    options.restoreLastFile = !parser.isSet(noRestoreOption);
+    if (!parser.positionalArguments().isEmpty()) {
+      options.initialFile =
+          QFileInfo(parser.positionalArguments().first()).absoluteFilePath();
+    }
+
+    if (parser.isSet(benchmarkOption)) {
+      // Keep the benchmark away from the user's state and recent files.
+      // Without the decode cache every iteration measures a full decode
+      // rather than mapping the first iteration's result.
+      QTemporaryDir stateDir;
+      qputenv("XDG_DATA_HOME", stateDir.path().toLocal8Bit());
+      qputenv("NEAT_DECODE_CACHE_MB", "0");
+      options.restoreLastFile = false;
+
+      ImagePresenter window(options);
+      const int status =
+          runLoadBenchmark(window, parser.values(benchmarkOption),
+                           qMax(1, parser.value(iterationsOption).toInt()));
+      // The state the loads saved goes into the temporary directory, which
+      // is removed on return
+      StateStore::instance().flush();
+      return status;
+    }
+
+    ImagePresenter window(options);
     window.show();
 
+    // Later launches with a file argument open it in this window
+    InstanceServer instanceServer;
+    QObject::connect(&instanceServer, &InstanceServer::fileRequested, &window,
+                     &ImagePresenter::openForwardedFile);
+    if (!parser.isSet(newInstanceOption) && !instanceServer.listen()) {
+      qWarning() << "Another Neat window is taking forwarded files, or the "
+                    "instance socket is unavailable; files opened from now "
+                    "on start a new window";
+      utils::log_session(LogLevel::Warning,
+                         "Single-instance mode is off: could not listen on "
+                         "the instance socket");
+    }
+
+    if (parser.isSet(startupTraceOption) || parser.isSet(startupBudgetOption)) {
+      const qreal budgetMs = parser.value(startupBudgetOption).toDouble();
+      QObject::connect(&window, &ImagePresenter::startupComplete, &app,
+                       [budgetMs]() {
+                         std::fputs(qPrintable(StartupTrace::report()),
+                                    stderr);
+                         if (budgetMs <= 0) {
+                           return;
+                         }
+                         const qreal firstPaintMs =
+                             StartupTrace::elapsedMs("first paint");
+                         if (firstPaintMs > budgetMs) {
+                           std::fprintf(stderr,
+                                        "First paint after %.2f ms exceeds "
+                                        "the budget of %.2f ms\n",
+                                        firstPaintMs, budgetMs);
+                           QCoreApplication::exit(2);
+                         } else {
+                           QCoreApplication::exit(0);
+                         }
+                       });
+    }
+
+    // The last change before quitting is saved while the event loop and
+    // the store are still around, not left to static destructors
+    QObject::connect(&app, &QCoreApplication::aboutToQuit,
+                     []() { StateStore::instance().flush(); });
+
     utils::log_session("Application started");
 
     return app.exec();
@@ -23,4 +237,4 @@ int main(int argc, char *argv[]) {
     qCritical() << "Unknown fatal error occurred";
     return 1;
   }
-}
\ No newline at end of file
+}
@@ -0,0 +1,153 @@
+#include "navigation_animator.h"
+#include "custom_graphics_view.h"
+#include <QScreen>
+#include <cmath>
+
+namespace {
+
+constexpr qreal kDefaultRefreshRate = 60.0;
+
+// Refresh intervals a step waits for its frame before the animation goes
+// on without it, e.g. while the window is hidden
+constexpr int kStallFrames = 4;
+
+} // namespace
+
+bool NavigationAnimator::FrameStats::heldRefreshRate() const {
+  return missedFrames == 0 && refreshRate > 0 &&
+         maxRenderMs <= 1000.0 / refreshRate;
+}
+
+QString NavigationAnimator::FrameStats::summary() const {
+  return QString("%1 frames in %2 ms at %3 Hz, %4 missed, interval avg "
+                 "%5 ms max %6 ms, render avg %7 ms max %8 ms (%9)")
+      .arg(frames)
+      .arg(durationMs, 0, 'f', 1)
+      .arg(refreshRate, 0, 'f', 0)
+      .arg(missedFrames)
+      .arg(averageIntervalMs, 0, 'f', 2)
+      .arg(maxIntervalMs, 0, 'f', 2)
+      .arg(averageRenderMs, 0, 'f', 2)
+      .arg(maxRenderMs, 0, 'f', 2)
+      .arg(QString(heldRefreshRate() ? "held refresh rate"
+                                     : "missed refresh rate"));
+}
+
+NavigationAnimator::NavigationAnimator(CustomGraphicsView *view,
+                                       QObject *parent)
+    : QObject(parent), m_view(view), m_easing(QEasingCurve::InOutCubic),
+      m_duration(500), m_startZoom(1.0), m_endZoom(1.0), m_running(false),
+      m_awaitingFrame(false), m_frameIntervalMs(1000.0 / kDefaultRefreshRate),
+      m_lastFrameNsecs(0), m_renderTotalMs(0.0) {
+  m_timer.setSingleShot(true);
+  m_timer.setTimerType(Qt::PreciseTimer);
+  connect(&m_timer, &QTimer::timeout, this, &NavigationAnimator::step);
+  connect(m_view, &CustomGraphicsView::frameRendered, this,
+          &NavigationAnimator::recordRender);
+}
+
+void NavigationAnimator::start(const QPointF &startCenter, qreal startZoom,
+                               const QPointF &endCenter, qreal endZoom) {
+  stop();
+
+  m_startCenter = startCenter;
+  m_endCenter = endCenter;
+  m_startZoom = startZoom;
+  m_endZoom = endZoom;
+
+  qreal refreshRate =
+      m_view->screen() ? m_view->screen()->refreshRate() : 0.0;
+  if (refreshRate <= 0.0) {
+    refreshRate = kDefaultRefreshRate;
+  }
+  m_frameIntervalMs = 1000.0 / refreshRate;
+
+  m_stats = FrameStats();
+  m_stats.refreshRate = refreshRate;
+  m_renderTotalMs = 0.0;
+
+  m_view->setTransformationAnchor(QGraphicsView::AnchorViewCenter);
+
+  m_clock.start();
+  m_lastFrameNsecs = 0;
+  m_running = true;
+  m_awaitingFrame = false;
+  scheduleStep();
+}
+
+void NavigationAnimator::stop() {
+  m_timer.stop();
+  m_running = false;
+  m_awaitingFrame = false;
+}
+
+void NavigationAnimator::scheduleStep() {
+  // The next refresh boundary after now, so late frames never shift the
+  // boundaries that follow
+  const qreal nowMs = m_clock.nsecsElapsed() / 1e6;
+  const qreal nextMs =
+      (std::floor(nowMs / m_frameIntervalMs) + 1) * m_frameIntervalMs;
+  m_timer.start(qMax(0, static_cast<int>(std::ceil(nextMs - nowMs))));
+}
+
+void NavigationAnimator::step() {
+  // Also reached when the last step's frame never came; the animation
+  // carries on rather than stall
+  m_awaitingFrame = false;
+  const qint64 now = m_clock.nsecsElapsed();
+  const qreal progress = qMin<qreal>(1.0, now / 1e6 / qMax(1, m_duration));
+  apply(progress);
+
+  if (progress >= 1.0) {
+    finish();
+    return;
+  }
+  // Resumed by the painted frame; the timer only covers a frame that is
+  // never painted
+  m_awaitingFrame = true;
+  m_timer.start(qMax(1, qRound(kStallFrames * m_frameIntervalMs)));
+}
+
+void NavigationAnimator::apply(qreal progress) {
+  const qreal t = m_easing.valueForProgress(progress);
+  const qreal zoom = (1 - t) * m_startZoom + t * m_endZoom;
+  const QPointF center = m_startCenter + (m_endCenter - m_startCenter) * t;
+
+  m_view->beginMotion();
+  m_view->setViewState(center, zoom);
+}
+
+void NavigationAnimator::recordRender(qint64 nsecs) {
+  if (!isRunning()) {
+    return;
+  }
+  const qreal ms = nsecs / 1e6;
+  m_renderTotalMs += ms;
+  m_stats.maxRenderMs = qMax(m_stats.maxRenderMs, ms);
+
+  const qint64 now = m_clock.nsecsElapsed();
+  ++m_stats.frames;
+  m_stats.maxIntervalMs =
+      qMax(m_stats.maxIntervalMs, (now - m_lastFrameNsecs) / 1e6);
+  m_lastFrameNsecs = now;
+
+  if (m_awaitingFrame) {
+    m_awaitingFrame = false;
+    scheduleStep();
+  }
+}
+
+void NavigationAnimator::finish() {
+  stop();
+
+  m_stats.durationMs = m_clock.nsecsElapsed() / 1e6;
+  m_stats.averageIntervalMs =
+      m_stats.frames > 0 ? m_stats.durationMs / m_stats.frames : 0.0;
+  // Every refresh interval of the animation should have had a frame
+  m_stats.missedFrames =
+      qMax(0, qRound(m_stats.durationMs / m_frameIntervalMs) - m_stats.frames);
+  m_stats.averageRenderMs =
+      m_stats.frames > 0 ? m_renderTotalMs / m_stats.frames : 0.0;
+
+  emit finished(m_stats);
+}
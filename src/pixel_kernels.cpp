@@ -0,0 +1,406 @@
+#include "pixel_kernels.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NEAT_X86_KERNELS 1
+#endif
+
+namespace pixel_kernels {
+
+namespace {
+
+inline std::uint32_t averageOf4(std::uint32_t a, std::uint32_t b,
+                                std::uint32_t c, std::uint32_t d) {
+  std::uint32_t result = 0;
+  for (int shift = 0; shift < 32; shift += 8) {
+    const std::uint32_t sum = ((a >> shift) & 0xff) + ((b >> shift) & 0xff) +
+                              ((c >> shift) & 0xff) + ((d >> shift) & 0xff);
+    result |= ((sum + 2) >> 2) << shift;
+  }
+  return result;
+}
+
+// Box-filters the pixel pair starting at `x` of two source rows; the last
+// column is repeated for odd widths
+inline std::uint32_t downsamplePixel(const std::uint32_t *row0,
+                                     const std::uint32_t *row1, int width,
+                                     int x) {
+  const int x1 = x + 1 < width ? x + 1 : x;
+  return averageOf4(row0[x], row0[x1], row1[x], row1[x1]);
+}
+
+void rgb888ToArgb32Scalar(const std::uint8_t *src, std::uint32_t *dst,
+                          int count) {
+  for (int i = 0; i < count; ++i, src += 3) {
+    dst[i] = 0xff000000u | (std::uint32_t(src[0]) << 16) |
+             (std::uint32_t(src[1]) << 8) | std::uint32_t(src[2]);
+  }
+}
+
+void premultiplyArgb32Scalar(const std::uint32_t *src, std::uint32_t *dst,
+                             int count) {
+  for (int i = 0; i < count; ++i) {
+    // Same arithmetic as qPremultiply()
+    std::uint32_t x = src[i];
+    const std::uint32_t a = x >> 24;
+    std::uint32_t t = (x & 0xff00ff) * a;
+    t = (t + ((t >> 8) & 0xff00ff) + 0x800080) >> 8;
+    t &= 0xff00ff;
+    x = ((x >> 8) & 0xff) * a;
+    x = (x + ((x >> 8) & 0xff) + 0x80);
+    x &= 0xff00;
+    dst[i] = x | t | (a << 24);
+  }
+}
+
+void downsampleRowScalar(const std::uint32_t *row0, const std::uint32_t *row1,
+                         int width, std::uint32_t *dst, int from) {
+  for (int x = from; x < width; x += 2) {
+    dst[x / 2] = downsamplePixel(row0, row1, width, x);
+  }
+}
+
+#ifdef NEAT_X86_KERNELS
+
+// --- SSE2 -----------------------------------------------------------------
+
+inline std::uint32_t load32(const std::uint8_t *p) {
+  std::uint32_t v;
+  std::memcpy(&v, p, 4);
+  return v;
+}
+
+__attribute__((target("sse2"))) void
+rgb888ToArgb32Sse2(const std::uint8_t *src, std::uint32_t *dst, int count) {
+  const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xff000000u));
+  const __m128i lowByte = _mm_set1_epi32(0xff);
+  const __m128i midByte = _mm_set1_epi32(0xff00);
+  int i = 0;
+  // Each group reads 13 bytes, one past its last pixel
+  for (; i + 5 <= count; i += 4) {
+    const std::uint8_t *p = src + 3 * i;
+    const __m128i v =
+        _mm_set_epi32(static_cast<int>(load32(p + 9)),
+                      static_cast<int>(load32(p + 6)),
+                      static_cast<int>(load32(p + 3)),
+                      static_cast<int>(load32(p)));
+    // v holds R | G << 8 | B << 16 per lane; swap R and B
+    const __m128i r = _mm_slli_epi32(_mm_and_si128(v, lowByte), 16);
+    const __m128i g = _mm_and_si128(v, midByte);
+    const __m128i b = _mm_and_si128(_mm_srli_epi32(v, 16), lowByte);
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i *>(dst + i),
+        _mm_or_si128(_mm_or_si128(r, g), _mm_or_si128(b, alpha)));
+  }
+  rgb888ToArgb32Scalar(src + 3 * i, dst + i, count - i);
+}
+
+// Premultiplies the colour channels of 16-bit unpacked pixels
+__attribute__((target("sse2"))) inline __m128i
+premultiply16Sse2(__m128i pixels) {
+  __m128i alpha = _mm_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3));
+  alpha = _mm_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+  __m128i t = _mm_mullo_epi16(pixels, alpha);
+  t = _mm_add_epi16(t, _mm_srli_epi16(t, 8));
+  t = _mm_add_epi16(t, _mm_set1_epi16(0x80));
+  return _mm_srli_epi16(t, 8);
+}
+
+__attribute__((target("sse2"))) void
+premultiplyArgb32Sse2(const std::uint32_t *src, std::uint32_t *dst,
+                      int count) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xff000000u));
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+    const __m128i lo = premultiply16Sse2(_mm_unpacklo_epi8(v, zero));
+    const __m128i hi = premultiply16Sse2(_mm_unpackhi_epi8(v, zero));
+    const __m128i colors =
+        _mm_andnot_si128(alphaMask, _mm_packus_epi16(lo, hi));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                     _mm_or_si128(colors, _mm_and_si128(v, alphaMask)));
+  }
+  premultiplyArgb32Scalar(src + i, dst + i, count - i);
+}
+
+// Sums the even and odd pixels of two rows channel by channel and rounds
+__attribute__((target("sse2"))) inline __m128i
+boxAverageSse2(__m128i even0, __m128i odd0, __m128i even1, __m128i odd1) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i two = _mm_set1_epi16(2);
+  __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(even0, zero),
+                             _mm_unpacklo_epi8(odd0, zero));
+  lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(even1, zero));
+  lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(odd1, zero));
+  lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+  __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(even0, zero),
+                             _mm_unpackhi_epi8(odd0, zero));
+  hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(even1, zero));
+  hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(odd1, zero));
+  hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+  return _mm_packus_epi16(lo, hi);
+}
+
+__attribute__((target("sse2"))) void
+downsampleRowSse2(const std::uint32_t *row0, const std::uint32_t *row1,
+                  int width, std::uint32_t *dst) {
+  int x = 0;
+  // 8 source pixels -> 4 destination pixels, full pairs only
+  for (; x + 8 <= width; x += 8) {
+    const __m128 a0 = _mm_loadu_ps(reinterpret_cast<const float *>(row0 + x));
+    const __m128 b0 =
+        _mm_loadu_ps(reinterpret_cast<const float *>(row0 + x + 4));
+    const __m128 a1 = _mm_loadu_ps(reinterpret_cast<const float *>(row1 + x));
+    const __m128 b1 =
+        _mm_loadu_ps(reinterpret_cast<const float *>(row1 + x + 4));
+    const __m128i even0 =
+        _mm_castps_si128(_mm_shuffle_ps(a0, b0, _MM_SHUFFLE(2, 0, 2, 0)));
+    const __m128i odd0 =
+        _mm_castps_si128(_mm_shuffle_ps(a0, b0, _MM_SHUFFLE(3, 1, 3, 1)));
+    const __m128i even1 =
+        _mm_castps_si128(_mm_shuffle_ps(a1, b1, _MM_SHUFFLE(2, 0, 2, 0)));
+    const __m128i odd1 =
+        _mm_castps_si128(_mm_shuffle_ps(a1, b1, _MM_SHUFFLE(3, 1, 3, 1)));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x / 2),
+                     boxAverageSse2(even0, odd0, even1, odd1));
+  }
+  downsampleRowScalar(row0, row1, width, dst, x);
+}
+
+// --- AVX2 -----------------------------------------------------------------
+
+__attribute__((target("avx2"))) void
+rgb888ToArgb32Avx2(const std::uint8_t *src, std::uint32_t *dst, int count) {
+  // Per 128-bit lane: bytes 0..11 hold 4 RGB pixels -> B, G, R, 0 each
+  const __m256i shuffle = _mm256_setr_epi8(
+      2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1, //
+      2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+  const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xff000000u));
+  int i = 0;
+  // Each group reads 28 bytes, four past its last pixel
+  for (; i + 10 <= count; i += 8) {
+    const std::uint8_t *p = src + 3 * i;
+    const __m256i v = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(p))),
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 12)), 1);
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i *>(dst + i),
+        _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle), alpha));
+  }
+  rgb888ToArgb32Sse2(src + 3 * i, dst + i, count - i);
+}
+
+__attribute__((target("avx2"))) inline __m256i
+premultiply16Avx2(__m256i pixels) {
+  __m256i alpha = _mm256_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3));
+  alpha = _mm256_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+  __m256i t = _mm256_mullo_epi16(pixels, alpha);
+  t = _mm256_add_epi16(t, _mm256_srli_epi16(t, 8));
+  t = _mm256_add_epi16(t, _mm256_set1_epi16(0x80));
+  return _mm256_srli_epi16(t, 8);
+}
+
+__attribute__((target("avx2"))) void
+premultiplyArgb32Avx2(const std::uint32_t *src, std::uint32_t *dst,
+                      int count) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i alphaMask =
+      _mm256_set1_epi32(static_cast<int>(0xff000000u));
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+    // Unpack and pack both work within 128-bit lanes, so order is kept
+    const __m256i lo = premultiply16Avx2(_mm256_unpacklo_epi8(v, zero));
+    const __m256i hi = premultiply16Avx2(_mm256_unpackhi_epi8(v, zero));
+    const __m256i colors =
+        _mm256_andnot_si256(alphaMask, _mm256_packus_epi16(lo, hi));
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i *>(dst + i),
+        _mm256_or_si256(colors, _mm256_and_si256(v, alphaMask)));
+  }
+  premultiplyArgb32Sse2(src + i, dst + i, count - i);
+}
+
+__attribute__((target("avx2"))) void
+downsampleRowAvx2(const std::uint32_t *row0, const std::uint32_t *row1,
+                  int width, std::uint32_t *dst) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i two = _mm256_set1_epi16(2);
+  int x = 0;
+  // 16 source pixels -> 8 destination pixels, full pairs only
+  for (; x + 16 <= width; x += 16) {
+    const __m256 a0 =
+        _mm256_loadu_ps(reinterpret_cast<const float *>(row0 + x));
+    const __m256 b0 =
+        _mm256_loadu_ps(reinterpret_cast<const float *>(row0 + x + 8));
+    const __m256 a1 =
+        _mm256_loadu_ps(reinterpret_cast<const float *>(row1 + x));
+    const __m256 b1 =
+        _mm256_loadu_ps(reinterpret_cast<const float *>(row1 + x + 8));
+    // In-lane shuffles leave the outputs as 0 1 4 5 | 2 3 6 7
+    const __m256i even0 = _mm256_castps_si256(
+        _mm256_shuffle_ps(a0, b0, _MM_SHUFFLE(2, 0, 2, 0)));
+    const __m256i odd0 = _mm256_castps_si256(
+        _mm256_shuffle_ps(a0, b0, _MM_SHUFFLE(3, 1, 3, 1)));
+    const __m256i even1 = _mm256_castps_si256(
+        _mm256_shuffle_ps(a1, b1, _MM_SHUFFLE(2, 0, 2, 0)));
+    const __m256i odd1 = _mm256_castps_si256(
+        _mm256_shuffle_ps(a1, b1, _MM_SHUFFLE(3, 1, 3, 1)));
+
+    __m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(even0, zero),
+                                  _mm256_unpacklo_epi8(odd0, zero));
+    lo = _mm256_add_epi16(lo, _mm256_unpacklo_epi8(even1, zero));
+    lo = _mm256_add_epi16(lo, _mm256_unpacklo_epi8(odd1, zero));
+    lo = _mm256_srli_epi16(_mm256_add_epi16(lo, two), 2);
+    __m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(even0, zero),
+                                  _mm256_unpackhi_epi8(odd0, zero));
+    hi = _mm256_add_epi16(hi, _mm256_unpackhi_epi8(even1, zero));
+    hi = _mm256_add_epi16(hi, _mm256_unpackhi_epi8(odd1, zero));
+    hi = _mm256_srli_epi16(_mm256_add_epi16(hi, two), 2);
+
+    const __m256i packed = _mm256_packus_epi16(lo, hi);
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i *>(dst + x / 2),
+        _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0)));
+  }
+  downsampleRowSse2(row0 + x, row1 + x, width - x, dst + x / 2);
+}
+
+#endif // NEAT_X86_KERNELS
+
+void downsampleRowScalarFromStart(const std::uint32_t *row0,
+                                  const std::uint32_t *row1, int width,
+                                  std::uint32_t *dst) {
+  downsampleRowScalar(row0, row1, width, dst, 0);
+}
+
+struct KernelTable {
+  Isa isa;
+  void (*rgb888ToArgb32)(const std::uint8_t *, std::uint32_t *, int);
+  void (*premultiplyArgb32)(const std::uint32_t *, std::uint32_t *, int);
+  void (*downsampleRow)(const std::uint32_t *, const std::uint32_t *, int,
+                        std::uint32_t *);
+};
+
+// NEAT_PIXEL_ISA=scalar|sse2|avx2 caps the tier the kernels may use, e.g.
+// to compare output; unset means no cap
+Isa maxIsa() {
+  const char *configured = std::getenv("NEAT_PIXEL_ISA");
+  if (!configured || !*configured) {
+    return Isa::AVX2;
+  }
+  const std::string name = configured;
+  if (name == "scalar") {
+    return Isa::Scalar;
+  }
+  if (name == "sse2") {
+    return Isa::SSE2;
+  }
+  if (name != "avx2") {
+    std::cerr << "Ignoring invalid NEAT_PIXEL_ISA: " << name << std::endl;
+  }
+  return Isa::AVX2;
+}
+
+KernelTable selectKernels() {
+  const Isa limit = maxIsa();
+
+#ifdef NEAT_X86_KERNELS
+  __builtin_cpu_init();
+  if (limit >= Isa::AVX2 && __builtin_cpu_supports("avx2")) {
+    return {Isa::AVX2, rgb888ToArgb32Avx2, premultiplyArgb32Avx2,
+            downsampleRowAvx2};
+  }
+  if (limit >= Isa::SSE2 && __builtin_cpu_supports("sse2")) {
+    return {Isa::SSE2, rgb888ToArgb32Sse2, premultiplyArgb32Sse2,
+            downsampleRowSse2};
+  }
+#endif
+
+  return {Isa::Scalar, rgb888ToArgb32Scalar, premultiplyArgb32Scalar,
+          downsampleRowScalarFromStart};
+}
+
+const KernelTable &kernels() {
+  static const KernelTable table = selectKernels();
+  return table;
+}
+
+template <typename RowFunction>
+void downsampleRows(const std::uint32_t *src, int srcStride, int width,
+                    int height, std::uint32_t *dst, int dstStride,
+                    RowFunction downsampleRow) {
+  const auto *srcBytes = reinterpret_cast<const std::uint8_t *>(src);
+  auto *dstBytes = reinterpret_cast<std::uint8_t *>(dst);
+  for (int y = 0; y < height; y += 2) {
+    const int y1 = y + 1 < height ? y + 1 : y;
+    downsampleRow(
+        reinterpret_cast<const std::uint32_t *>(srcBytes +
+                                                std::size_t(y) * srcStride),
+        reinterpret_cast<const std::uint32_t *>(srcBytes +
+                                                std::size_t(y1) * srcStride),
+        width,
+        reinterpret_cast<std::uint32_t *>(dstBytes +
+                                          std::size_t(y / 2) * dstStride));
+  }
+}
+
+} // namespace
+
+Isa activeIsa() { return kernels().isa; }
+
+const char *isaName(Isa isa) {
+  switch (isa) {
+  case Isa::AVX2:
+    return "AVX2";
+  case Isa::SSE2:
+    return "SSE2";
+  case Isa::Scalar:
+    break;
+  }
+  return "scalar";
+}
+
+void rgb888ToArgb32(const std::uint8_t *src, std::uint32_t *dst, int count) {
+  kernels().rgb888ToArgb32(src, dst, count);
+}
+
+void premultiplyArgb32(const std::uint32_t *src, std::uint32_t *dst,
+                       int count) {
+  kernels().premultiplyArgb32(src, dst, count);
+}
+
+void downsample2xArgb32(const std::uint32_t *src, int srcStride, int width,
+                        int height, std::uint32_t *dst, int dstStride) {
+  downsampleRows(src, srcStride, width, height, dst, dstStride,
+                 kernels().downsampleRow);
+}
+
+namespace reference {
+
+void rgb888ToArgb32(const std::uint8_t *src, std::uint32_t *dst, int count) {
+  rgb888ToArgb32Scalar(src, dst, count);
+}
+
+void premultiplyArgb32(const std::uint32_t *src, std::uint32_t *dst,
+                       int count) {
+  premultiplyArgb32Scalar(src, dst, count);
+}
+
+void downsample2xArgb32(const std::uint32_t *src, int srcStride, int width,
+                        int height, std::uint32_t *dst, int dstStride) {
+  downsampleRows(src, srcStride, width, height, dst, dstStride,
+                 downsampleRowScalarFromStart);
+}
+
+} // namespace reference
+
+} // namespace pixel_kernels
@@ -0,0 +1,79 @@
+#include "raster_conversion.h"
+#include "pixel_kernels.h"
+
+namespace {
+
+QImage rgb888ToRgb32(const QImage &image) {
+  QImage result(image.size(), QImage::Format_RGB32);
+  for (int y = 0; y < image.height(); ++y) {
+    pixel_kernels::rgb888ToArgb32(
+        image.constScanLine(y),
+        reinterpret_cast<std::uint32_t *>(result.scanLine(y)), image.width());
+  }
+  result.setDotsPerMeterX(image.dotsPerMeterX());
+  result.setDotsPerMeterY(image.dotsPerMeterY());
+  return result;
+}
+
+} // namespace
+
+QImage toStraight32(QImage image) {
+  switch (image.format()) {
+  case QImage::Format_RGB32:
+  case QImage::Format_ARGB32:
+    return image;
+  case QImage::Format_RGB888:
+    return rgb888ToRgb32(image);
+  default:
+    image.convertTo(image.hasAlphaChannel() ? QImage::Format_ARGB32
+                                            : QImage::Format_RGB32);
+    return image;
+  }
+}
+
+QImage toDisplayFormat(QImage image) {
+  switch (image.format()) {
+  case QImage::Format_RGB32:
+  case QImage::Format_ARGB32_Premultiplied:
+    return image;
+  case QImage::Format_RGB888:
+    return rgb888ToRgb32(image);
+  case QImage::Format_ARGB32:
+    for (int y = 0; y < image.height(); ++y) {
+      auto *line = reinterpret_cast<std::uint32_t *>(image.scanLine(y));
+      pixel_kernels::premultiplyArgb32(line, line, image.width());
+    }
+    image.reinterpretAsFormat(QImage::Format_ARGB32_Premultiplied);
+    return image;
+  default:
+    image.convertTo(image.hasAlphaChannel()
+                        ? QImage::Format_ARGB32_Premultiplied
+                        : QImage::Format_RGB32);
+    return image;
+  }
+}
+
+QImage downsample2x(const QImage &image) {
+  QImage result((image.width() + 1) / 2, (image.height() + 1) / 2,
+                image.format());
+  pixel_kernels::downsample2xArgb32(
+      reinterpret_cast<const std::uint32_t *>(image.constBits()),
+      static_cast<int>(image.bytesPerLine()), image.width(), image.height(),
+      reinterpret_cast<std::uint32_t *>(result.bits()),
+      static_cast<int>(result.bytesPerLine()));
+  return result;
+}
+
+bool isHalvedSize(const QSize &source, const QSize &size, int &levels) {
+  levels = 0;
+  if (size.isEmpty()) {
+    return false;
+  }
+  QSize current = source;
+  for (levels = 0; current.width() > size.width() ||
+                   current.height() > size.height();
+       ++levels) {
+    current = QSize((current.width() + 1) / 2, (current.height() + 1) / 2);
+  }
+  return current == size;
+}
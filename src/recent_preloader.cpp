@@ -0,0 +1,150 @@
+#include "recent_preloader.h"
+#include <QFileInfo>
+#include <QPromise>
+#include <QtConcurrent/QtConcurrentRun>
+#include <utility>
+
+namespace {
+
+// Tile cache of a pyramid waiting in the preloader; the fitted view of a
+// 4K viewport needs about 32 MiB
+constexpr qint64 kPreloadTileCacheBytes = qint64(32) << 20;
+
+// Runs on the thread pool: the load, then for tiled images the tiles of
+// the whole image at the zoom the view opens it with. A cancelled preload
+// stops at the next tile and reports no result.
+void preload(QPromise<LoadedContent> &promise, const QString &filePath,
+             qint64 maxBytes, const QSize &viewportSize,
+             qreal devicePixelRatio) {
+  LoadedContent content = loadContent(filePath, maxBytes);
+  if (promise.isCanceled()) {
+    return;
+  }
+  if (content.ok() && content.kind == LoadedContent::Kind::Tiled &&
+      !viewportSize.isEmpty()) {
+    auto pyramid = std::make_shared<TilePyramid>(content.decoder);
+    pyramid->setCacheLimit(
+        qMin(content.tileCacheBytes, kPreloadTileCacheBytes));
+
+    const QSize size = pyramid->size();
+    const qreal fitScale =
+        qMin(qreal(viewportSize.width()) / size.width(),
+             qreal(viewportSize.height()) / size.height());
+    pyramid->prefetch(QRectF(QPointF(0, 0), size),
+                      fitScale * devicePixelRatio);
+    pyramid->prefetchAll([&promise]() { return promise.isCanceled(); });
+    content.pyramid = std::move(pyramid);
+  }
+  promise.addResult(std::move(content));
+}
+
+} // namespace
+
+RecentPreloader::RecentPreloader(QObject *parent)
+    : QObject(parent), m_budget(0), m_usedBytes(0), m_devicePixelRatio(1.0),
+      m_adopted(false) {
+  connect(&m_watcher, &QFutureWatcher<LoadedContent>::finished, this,
+          &RecentPreloader::finishLoad);
+}
+
+void RecentPreloader::setBudget(qint64 bytes) { m_budget = bytes; }
+
+void RecentPreloader::setViewport(const QSize &size, qreal devicePixelRatio) {
+  m_viewportSize = size;
+  m_devicePixelRatio = devicePixelRatio;
+}
+
+void RecentPreloader::setCandidates(const QStringList &filePaths) {
+  m_candidates = filePaths;
+  for (auto it = m_ready.begin(); it != m_ready.end();) {
+    if (filePaths.contains(it->first)) {
+      ++it;
+    } else {
+      m_usedBytes -= it->second.cost;
+      it = m_ready.erase(it);
+    }
+  }
+}
+
+bool RecentPreloader::take(const QString &filePath, LoadedContent &content) {
+  const auto it = m_ready.find(filePath);
+  if (it == m_ready.end()) {
+    return false;
+  }
+  Entry entry = std::move(it->second);
+  m_usedBytes -= entry.cost;
+  m_ready.erase(it);
+
+  // Changed on disk since it was decoded
+  if (entry.modified != QFileInfo(filePath).lastModified()) {
+    return false;
+  }
+  content = std::move(entry.content);
+  return true;
+}
+
+QFuture<LoadedContent> RecentPreloader::adopt(const QString &filePath) {
+  if (filePath.isEmpty() || m_loading != filePath || m_watcher.isCanceled() ||
+      m_loadingModified != QFileInfo(filePath).lastModified()) {
+    return QFuture<LoadedContent>();
+  }
+  m_adopted = true;
+  return m_watcher.future();
+}
+
+void RecentPreloader::cancel() {
+  if (!m_loading.isEmpty()) {
+    m_watcher.cancel();
+  }
+}
+
+void RecentPreloader::preloadNext() {
+  if (!m_loading.isEmpty() || m_usedBytes >= m_budget) {
+    return;
+  }
+  for (const QString &filePath : m_candidates) {
+    if (m_ready.count(filePath) == 0 && !m_rejected.contains(filePath)) {
+      m_loading = filePath;
+      // Taken before decoding, so a change made meanwhile is noticed
+      m_loadingModified = QFileInfo(filePath).lastModified();
+      // Files too large for what is left of the budget fail from their
+      // header instead of being decoded and thrown away
+      m_watcher.setFuture(QtConcurrent::run(preload, filePath,
+                                            m_budget - m_usedBytes,
+                                            m_viewportSize,
+                                            m_devicePixelRatio));
+      return;
+    }
+  }
+}
+
+void RecentPreloader::finishLoad() {
+  const QString filePath = std::exchange(m_loading, QString());
+  const bool adopted = std::exchange(m_adopted, false);
+  const QFuture<LoadedContent> future = m_watcher.future();
+  // Given up for a load of the user's, which may pick it up again later,
+  // or handed over to one
+  if (adopted || future.isCanceled() || future.resultCount() == 0) {
+    emit loadFinished();
+    return;
+  }
+  LoadedContent content = future.result();
+
+  if (!content.ok()) {
+    m_rejected.insert(filePath);
+  } else if (m_candidates.contains(filePath)) {
+    const qint64 cost = costOf(content);
+    if (m_usedBytes + cost > m_budget) {
+      m_rejected.insert(filePath);
+    } else {
+      m_usedBytes += cost;
+      m_ready[filePath] = Entry{std::move(content), m_loadingModified, cost};
+    }
+  }
+  emit loadFinished();
+}
+
+qint64 RecentPreloader::costOf(const LoadedContent &content) const {
+  return content.decodedBytes +
+         (content.pyramid ? kPreloadTileCacheBytes : 0);
+}
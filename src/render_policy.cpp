@@ -0,0 +1,186 @@
+#include "render_policy.h"
+#include "custom_graphics_view.h"
+#include <algorithm>
+
+namespace {
+
+// Full-quality frames after new content that are not sampled: they pay for
+// cold tile decodes and pixmap uploads the frames after them do not
+constexpr int kWarmUpFrames = 2;
+
+// Full-quality frames whose median paint time makes the measured decision
+constexpr int kSampleFrames = 5;
+
+// Paint cost above which an item is worth caching: one 60 Hz frame
+constexpr qreal kFrameBudgetMs = 16.0;
+
+// Vector content this slow is cached at a fixed resolution, so zooming
+// scales a pixmap instead of re-rendering the document at every step
+constexpr qreal kVerySlowPaintMs = 4 * kFrameBudgetMs;
+
+// Longest side of an ItemCoordinateCache pixmap
+constexpr int kMaxItemCacheSide = 8192;
+
+const char *contentName(RenderPolicy::Content content) {
+  switch (content) {
+  case RenderPolicy::Content::None:
+    return "none";
+  case RenderPolicy::Content::Raster:
+    return "raster";
+  case RenderPolicy::Content::TiledRaster:
+    return "tiled raster";
+  case RenderPolicy::Content::Vector:
+    return "vector";
+  }
+  return "unknown";
+}
+
+const char *cacheModeName(QGraphicsItem::CacheMode mode) {
+  switch (mode) {
+  case QGraphicsItem::NoCache:
+    return "no cache";
+  case QGraphicsItem::ItemCoordinateCache:
+    return "item coordinate cache";
+  case QGraphicsItem::DeviceCoordinateCache:
+    return "device coordinate cache";
+  }
+  return "unknown";
+}
+
+const char *updateModeName(QGraphicsView::ViewportUpdateMode mode) {
+  switch (mode) {
+  case QGraphicsView::FullViewportUpdate:
+    return "full";
+  case QGraphicsView::MinimalViewportUpdate:
+    return "minimal";
+  case QGraphicsView::SmartViewportUpdate:
+    return "smart";
+  case QGraphicsView::BoundingRectViewportUpdate:
+    return "bounding rect";
+  case QGraphicsView::NoViewportUpdate:
+    return "none";
+  }
+  return "unknown";
+}
+
+} // namespace
+
+QString RenderPolicy::Decision::summary() const {
+  QString cache = cacheModeName(cacheMode);
+  if (cacheMode == QGraphicsItem::ItemCoordinateCache) {
+    cache += QString(" %1x%2").arg(cacheSize.width()).arg(cacheSize.height());
+  }
+  const QString paint = paintMs < 0
+                            ? QString("not measured yet")
+                            : QString("%1 ms").arg(paintMs, 0, 'f', 2);
+  const QString background =
+      backgroundCache == QGraphicsView::CacheNone ? "off" : "on";
+  return QString("Content: %1\nItem cache: %2\nBackground cache: %3\n"
+                 "Viewport updates: %4\nMedian paint: %5\nReason: %6")
+      .arg(contentName(content), cache, background,
+           updateModeName(updateMode), paint, reason);
+}
+
+RenderPolicy::RenderPolicy(CustomGraphicsView *view, QObject *parent)
+    : QObject(parent), m_view(view), m_item(nullptr), m_skippedFrames(0) {
+  connect(m_view, &CustomGraphicsView::frameRendered, this,
+          &RenderPolicy::recordFrame);
+}
+
+void RenderPolicy::setContent(QGraphicsItem *item, Content content) {
+  m_item = item;
+  m_skippedFrames = 0;
+  m_samples.clear();
+
+  m_decision = Decision();
+  m_decision.content = content;
+  switch (content) {
+  case Content::None:
+    m_decision.reason = "nothing loaded";
+    break;
+  case Content::Raster:
+    // One pixmap: partial repaints only redraw the exposed part of it
+    m_decision.reason = "decoded pixmap, caching starts uncached";
+    break;
+  case Content::TiledRaster:
+    // The tile pyramid is the cache; a second one would hold the same
+    // pixels at another resolution. Scrolling exposes many small strips,
+    // which smart updates merge when that is cheaper.
+    m_decision.updateMode = QGraphicsView::SmartViewportUpdate;
+    m_decision.reason = "tiles are cached by the pyramid";
+    break;
+  case Content::Vector:
+    m_decision.reason = "vector, caching starts uncached";
+    break;
+  }
+  apply();
+}
+
+void RenderPolicy::recordFrame(qint64 nsecs) {
+  // Only full-quality frames of the item itself tell what it costs
+  if (!m_item || int(m_samples.size()) >= kSampleFrames ||
+      m_view->renderQuality() != CustomGraphicsView::RenderQuality::Full ||
+      m_view->renderMode() != CustomGraphicsView::RenderMode::Direct) {
+    return;
+  }
+  if (m_skippedFrames < kWarmUpFrames) {
+    ++m_skippedFrames;
+    return;
+  }
+  m_samples.push_back(nsecs);
+  if (int(m_samples.size()) == kSampleFrames) {
+    decide();
+  }
+}
+
+void RenderPolicy::decide() {
+  // The median ignores a single slow frame, e.g. one that met a tile or
+  // glyph cache miss
+  std::vector<qint64> sorted = m_samples;
+  std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2,
+                   sorted.end());
+  const qreal paintMs = sorted[sorted.size() / 2] / 1e6;
+  m_decision.paintMs = paintMs;
+
+  if (m_decision.content == Content::Raster ||
+      m_decision.content == Content::Vector) {
+    if (paintMs > kVerySlowPaintMs &&
+        m_decision.content == Content::Vector) {
+      // Cache at twice the viewport's device pixels, so moderate zooming
+      // stays sharp
+      const QSizeF itemSize = m_item->boundingRect().size();
+      const QSize viewPixels =
+          m_view->viewport()->size() * m_view->devicePixelRatioF();
+      const qreal side =
+          qMin<qreal>(kMaxItemCacheSide,
+                      2.0 * qMax(viewPixels.width(), viewPixels.height()));
+      m_decision.cacheMode = QGraphicsItem::ItemCoordinateCache;
+      m_decision.cacheSize = itemSize.scaled(side, side, Qt::KeepAspectRatio)
+                                 .toSize()
+                                 .expandedTo(QSize(1, 1));
+      m_decision.reason = "paint far over the frame budget";
+    } else if (paintMs > kFrameBudgetMs) {
+      // Panning and repeated frames reuse the cached device pixels; only
+      // zoom changes repaint the item
+      m_decision.cacheMode = QGraphicsItem::DeviceCoordinateCache;
+      m_decision.reason = "paint over the frame budget";
+    } else {
+      m_decision.reason = "paint within the frame budget, no cache needed";
+    }
+  }
+  // The background is a plain fill that costs next to nothing to redraw;
+  // next to a cached item its viewport-sized pixmap is only more memory
+  if (m_decision.cacheMode != QGraphicsItem::NoCache) {
+    m_decision.backgroundCache = QGraphicsView::CacheNone;
+  }
+  apply();
+}
+
+void RenderPolicy::apply() {
+  if (m_item) {
+    m_item->setCacheMode(m_decision.cacheMode, m_decision.cacheSize);
+  }
+  m_view->setCacheMode(m_decision.backgroundCache);
+  m_view->setViewportUpdateMode(m_decision.updateMode);
+  emit decisionChanged(m_decision);
+}
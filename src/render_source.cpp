@@ -0,0 +1,205 @@
+#include "render_source.h"
+#include "tile_pyramid.h"
+#include <QCoreApplication>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPainter>
+#include <QSvgRenderer>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentMap>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+class ImageSource : public RenderSource {
+public:
+  explicit ImageSource(QImage image) : m_image(std::move(image)) {}
+
+  void paint(QPainter *painter, const QRectF &exposed) override {
+    const QRectF area = exposed.intersected(m_image.rect());
+    if (!area.isEmpty()) {
+      painter->drawImage(area, m_image, area);
+    }
+  }
+
+private:
+  const QImage m_image;
+};
+
+class PyramidSource : public RenderSource {
+public:
+  explicit PyramidSource(std::shared_ptr<TilePyramid> pyramid)
+      : m_pyramid(std::move(pyramid)) {}
+
+  void paint(QPainter *painter, const QRectF &exposed) override {
+    m_pyramid->paint(painter, exposed);
+  }
+
+private:
+  std::shared_ptr<TilePyramid> m_pyramid;
+};
+
+// QSvgRenderer is not reentrant, so every concurrent paint borrows its own
+// renderer from a pool that grows to the number of painting threads.
+// Renderers are created on whichever painting thread needs one, so they are
+// made without an animation timer and detached from that thread before use;
+// the pool is deleted on the GUI thread.
+class SvgSource : public RenderSource {
+public:
+  explicit SvgSource(QByteArray content) : m_content(std::move(content)) {}
+
+  ~SvgSource() override {
+    const std::vector<QSvgRenderer *> renderers = std::move(m_idle);
+    QCoreApplication *app = QCoreApplication::instance();
+    if (!app || QThread::currentThread() == app->thread()) {
+      qDeleteAll(renderers);
+    } else {
+      QMetaObject::invokeMethod(
+          app, [renderers]() { qDeleteAll(renderers); }, Qt::QueuedConnection);
+    }
+  }
+
+  void paint(QPainter *painter, const QRectF &exposed) override {
+    QSvgRenderer *renderer = acquire();
+    if (renderer->isValid()) {
+      painter->save();
+      painter->setClipRect(exposed, Qt::IntersectClip);
+      // Same geometry as QGraphicsSvgItem
+      renderer->render(painter, QRectF(QPointF(0, 0), renderer->defaultSize()));
+      painter->restore();
+    }
+    release(renderer);
+  }
+
+private:
+  QSvgRenderer *acquire() {
+    {
+      QMutexLocker locker(&m_mutex);
+      if (!m_idle.empty()) {
+        QSvgRenderer *renderer = m_idle.back();
+        m_idle.pop_back();
+        return renderer;
+      }
+    }
+    auto *renderer = new QSvgRenderer();
+    // No frame rate means no animation timer, which would belong to this
+    // thread and fire or stop wherever the renderer is used later
+    renderer->setFramesPerSecond(0);
+    renderer->load(m_content);
+    renderer->moveToThread(nullptr);
+    return renderer;
+  }
+
+  void release(QSvgRenderer *renderer) {
+    QMutexLocker locker(&m_mutex);
+    m_idle.push_back(renderer);
+  }
+
+  const QByteArray m_content;
+  QMutex m_mutex;
+  std::vector<QSvgRenderer *> m_idle;
+};
+
+// Frame bands get threads of their own; on the global pool a paint would
+// wait behind the prefetch, snapshot and preload jobs queued there
+QThreadPool *bandPool() {
+  static QThreadPool pool;
+  return &pool;
+}
+
+// Bands thinner than this cost more in setup than they save
+constexpr int kMinBandRows = 64;
+
+struct Band {
+  uchar *bits; // First pixel row of the band in the frame
+  int firstRow;
+  int rows;
+};
+
+void paintBand(RenderSource &source, const QImage &frame, const Band &band,
+               const QRectF &sceneRect, const QRect &area,
+               QPainter::RenderHints hints, const QColor &background) {
+  // A QImage over the band's rows of the frame: a paint device can only
+  // have one active painter, but these share the pixels without copying
+  const qreal dpr = frame.devicePixelRatio();
+  QImage pixels(band.bits, frame.width(), band.rows, frame.bytesPerLine(),
+                frame.format());
+  pixels.setDevicePixelRatio(dpr);
+
+  const qreal top = band.firstRow / dpr;
+  const QRectF clip(area.left(), 0, area.width(), band.rows / dpr);
+
+  QPainter painter(&pixels);
+  painter.setRenderHints(hints);
+  painter.setCompositionMode(QPainter::CompositionMode_Source);
+  painter.fillRect(clip, background);
+  painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+  painter.setClipRect(clip);
+
+  const QSizeF size = frame.deviceIndependentSize();
+  QTransform transform;
+  transform.translate(0, -top);
+  transform.scale(size.width() / sceneRect.width(),
+                  size.height() / sceneRect.height());
+  transform.translate(-sceneRect.left(), -sceneRect.top());
+  painter.setWorldTransform(transform);
+
+  const QRectF exposed = transform.inverted().mapRect(clip);
+  source.paint(&painter, exposed);
+}
+
+} // namespace
+
+std::shared_ptr<RenderSource> RenderSource::fromImage(QImage image) {
+  return std::make_shared<ImageSource>(std::move(image));
+}
+
+std::shared_ptr<RenderSource>
+RenderSource::fromPyramid(std::shared_ptr<TilePyramid> pyramid) {
+  return std::make_shared<PyramidSource>(std::move(pyramid));
+}
+
+std::shared_ptr<RenderSource> RenderSource::fromSvg(QByteArray content) {
+  return std::make_shared<SvgSource>(std::move(content));
+}
+
+void renderFrame(RenderSource &source, QImage &frame, const QRectF &sceneRect,
+                 const QRect &area, QPainter::RenderHints hints,
+                 const QColor &background, int bands) {
+  if (sceneRect.isEmpty() || frame.isNull()) {
+    return;
+  }
+
+  // Rows of the frame covered by `area`
+  const qreal dpr = frame.devicePixelRatio();
+  const int firstRow =
+      qMax(0, static_cast<int>(std::floor(area.top() * dpr)));
+  const int endRow = qMin(
+      frame.height(), static_cast<int>(std::ceil((area.bottom() + 1) * dpr)));
+  if (endRow <= firstRow) {
+    return;
+  }
+
+  // bits() detaches, so call it here rather than from the band threads
+  uchar *bits = frame.bits();
+  const int rows = endRow - firstRow;
+  bands = qBound(1, qMin(bands, rows / kMinBandRows), rows);
+  std::vector<Band> split;
+  split.reserve(bands);
+  for (int i = 0; i < bands; ++i) {
+    const int start = firstRow + rows * i / bands;
+    const int end = firstRow + rows * (i + 1) / bands;
+    split.push_back({bits + start * frame.bytesPerLine(), start, end - start});
+  }
+
+  const auto paint = [&](const Band &band) {
+    paintBand(source, frame, band, sceneRect, area, hints, background);
+  };
+  if (split.size() == 1) {
+    paint(split.front());
+  } else {
+    QtConcurrent::blockingMap(bandPool(), split, paint);
+  }
+}
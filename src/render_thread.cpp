@@ -0,0 +1,79 @@
+#include "render_thread.h"
+#include <QElapsedTimer>
+#include <QMutexLocker>
+
+bool RenderThread::Request::operator==(const Request &other) const {
+  return source == other.source && sceneRect == other.sceneRect &&
+         size == other.size && devicePixelRatio == other.devicePixelRatio &&
+         hints == other.hints && background == other.background;
+}
+
+RenderThread::RenderThread(QObject *parent) : QThread(parent), m_quit(false) {}
+
+RenderThread::~RenderThread() {
+  {
+    QMutexLocker locker(&m_mutex);
+    m_quit = true;
+    m_wake.wakeOne();
+  }
+  wait();
+}
+
+void RenderThread::request(const Request &request) {
+  QMutexLocker locker(&m_mutex);
+  m_pending = request;
+  if (!isRunning()) {
+    start();
+  } else {
+    m_wake.wakeOne();
+  }
+}
+
+RenderThread::Frame RenderThread::latestFrame() const {
+  QMutexLocker locker(&m_mutex);
+  return m_front;
+}
+
+void RenderThread::run() {
+  forever {
+    Request request;
+    {
+      QMutexLocker locker(&m_mutex);
+      while (!m_pending && !m_quit) {
+        m_wake.wait(&m_mutex);
+      }
+      if (m_quit) {
+        return;
+      }
+      request = std::move(*m_pending);
+      m_pending.reset();
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // Reuse the back buffer unless the GUI thread still holds it
+    const QSize pixelSize = request.size * request.devicePixelRatio;
+    if (m_back.size() != pixelSize || !m_back.isDetached()) {
+      m_back = QImage(pixelSize, QImage::Format_ARGB32_Premultiplied);
+    }
+    m_back.setDevicePixelRatio(request.devicePixelRatio);
+    if (request.source) {
+      renderFrame(*request.source, m_back, request.sceneRect,
+                  QRect(QPoint(0, 0), request.size), request.hints,
+                  request.background);
+    } else {
+      m_back.fill(request.background);
+    }
+    const qint64 nsecs = timer.nsecsElapsed();
+
+    {
+      QMutexLocker locker(&m_mutex);
+      std::swap(m_front.image, m_back);
+      m_front.sceneRect = request.sceneRect;
+      m_front.renderNsecs = nsecs;
+      ++m_front.serial;
+    }
+    emit frameReady(nsecs);
+  }
+}
@@ -0,0 +1,305 @@
+#include "session_logger.h"
+#include "state_store.h"
+#include "utils.h"
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// How long a message may wait in the queue before it is written
+constexpr std::chrono::milliseconds kFlushInterval(250);
+
+// Queue length that wakes the writer before the interval is up
+constexpr int kBatchSize = 256;
+
+// Files are rotated past these sizes; log.1.txt is the newest old log.
+// Events are kept longer, since `neat stats` aggregates them.
+constexpr std::uint64_t kMaxLogBytes = std::uint64_t(4) << 20;
+constexpr std::uint64_t kMaxEventBytes = std::uint64_t(64) << 20;
+
+constexpr char kEventsName[] = "events";
+constexpr char kEventsExtension[] = ".jsonl";
+
+const char *levelName(LogLevel level) {
+  switch (level) {
+  case LogLevel::Debug:
+    return "debug";
+  case LogLevel::Info:
+    return "info";
+  case LogLevel::Warning:
+    return "warning";
+  case LogLevel::Error:
+    return "error";
+  }
+  return "info";
+}
+
+LogLevel configuredLevel() {
+  const std::string name = StateStore::instance().setting(settings::logLevel);
+  for (LogLevel level : {LogLevel::Debug, LogLevel::Info, LogLevel::Warning,
+                         LogLevel::Error}) {
+    if (name == levelName(level)) {
+      return level;
+    }
+  }
+  std::cerr << "Ignoring invalid log level: " << name << std::endl;
+  return LogLevel::Info;
+}
+
+fs::path outputPath(const std::string &directory, const std::string &name,
+                    const std::string &extension, int index) {
+  return fs::path(directory) /
+         (index == 0 ? name + extension
+                     : name + "." + std::to_string(index) + extension);
+}
+
+void appendJsonString(std::string &out, const std::string &text) {
+  out += '"';
+  for (const char c : text) {
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        char escaped[8];
+        std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+        out += escaped;
+      } else {
+        out += c;
+      }
+    }
+  }
+  out += '"';
+}
+
+void appendNumber(std::string &out, const char *key, double value) {
+  char number[32];
+  std::snprintf(number, sizeof(number), "%.10g", value);
+  out += ",\"";
+  out += key;
+  out += "\":";
+  out += number;
+}
+
+// Fixed key order: time, type, file, ms, bytes, extra values, error.
+// `neat stats` relies on the "key": spelling but not on the order.
+void appendEvent(std::string &out, std::chrono::system_clock::time_point time,
+                 const SessionEvent &event) {
+  out += "{\"t\":";
+  out += std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
+                            time.time_since_epoch())
+                            .count());
+  out += ",\"type\":";
+  appendJsonString(out, event.type);
+  if (!event.file.empty()) {
+    out += ",\"file\":";
+    appendJsonString(out, event.file);
+  }
+  if (event.ms >= 0) {
+    appendNumber(out, "ms", event.ms);
+  }
+  if (event.bytes >= 0) {
+    out += ",\"bytes\":";
+    out += std::to_string(event.bytes);
+  }
+  for (const auto &[key, value] : event.values) {
+    appendNumber(out, key, value);
+  }
+  if (!event.error.empty()) {
+    out += ",\"error\":";
+    appendJsonString(out, event.error);
+  }
+  out += "}\n";
+}
+
+} // namespace
+
+SessionLogger &SessionLogger::instance() {
+  static SessionLogger logger(utils::ensure_neat_directory(),
+                              configuredLevel());
+  return logger;
+}
+
+SessionLogger::SessionLogger(const std::string &directory, LogLevel minLevel)
+    : m_directory(directory), m_minLevel(minLevel), m_pending(nullptr),
+      m_pendingCount(0), m_logged(0), m_written(0), m_stopping(false),
+      m_flushRequested(false), m_log{"log", ".txt", kMaxLogBytes, {}, 0},
+      m_events{kEventsName, kEventsExtension, kMaxEventBytes, {}, 0} {
+  m_thread = std::thread(&SessionLogger::run, this);
+}
+
+SessionLogger::~SessionLogger() {
+  {
+    std::lock_guard<std::mutex> lock(m_wakeMutex);
+    m_stopping = true;
+  }
+  m_wake.notify_one();
+  m_thread.join();
+}
+
+void SessionLogger::log(LogLevel level, std::string message) {
+  if (!isEnabled(level)) {
+    return;
+  }
+  push(new Entry{nullptr, std::chrono::system_clock::now(), level,
+                 std::move(message), false, SessionEvent()});
+}
+
+void SessionLogger::event(SessionEvent event) {
+  push(new Entry{nullptr, std::chrono::system_clock::now(), LogLevel::Info,
+                 std::string(), true, std::move(event)});
+}
+
+void SessionLogger::push(Entry *entry) {
+  // Lock-free push; the writer takes the whole list at once
+  entry->next = m_pending.load(std::memory_order_relaxed);
+  while (!m_pending.compare_exchange_weak(entry->next, entry,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed)) {
+  }
+  m_logged.fetch_add(1, std::memory_order_relaxed);
+
+  if (m_pendingCount.fetch_add(1, std::memory_order_relaxed) + 1 ==
+      kBatchSize) {
+    m_wake.notify_one();
+  }
+}
+
+void SessionLogger::flush() {
+  const std::uint64_t target = m_logged.load();
+  std::unique_lock<std::mutex> lock(m_wakeMutex);
+  m_flushRequested = true;
+  m_wake.notify_one();
+  m_drained.wait(lock, [&]() { return m_written.load() >= target; });
+}
+
+void SessionLogger::run() {
+  open(m_log);
+  open(m_events);
+
+  std::unique_lock<std::mutex> lock(m_wakeMutex);
+  while (true) {
+    m_wake.wait_for(lock, kFlushInterval, [this]() {
+      return m_stopping || m_flushRequested ||
+             m_pendingCount.load() >= kBatchSize;
+    });
+    const bool stopping = m_stopping;
+    m_flushRequested = false;
+
+    lock.unlock();
+    while (writePending()) {
+    }
+    lock.lock();
+    m_drained.notify_all();
+
+    if (stopping) {
+      break;
+    }
+  }
+}
+
+bool SessionLogger::writePending() {
+  Entry *list = m_pending.exchange(nullptr, std::memory_order_acquire);
+  if (!list) {
+    return false;
+  }
+
+  // The list is newest first
+  Entry *ordered = nullptr;
+  int count = 0;
+  while (list) {
+    Entry *next = list->next;
+    list->next = ordered;
+    ordered = list;
+    list = next;
+    ++count;
+  }
+  m_pendingCount.fetch_sub(count, std::memory_order_relaxed);
+
+  std::string logBatch;
+  std::string eventBatch;
+  char timestamp[32];
+  while (ordered) {
+    if (ordered->isEvent) {
+      appendEvent(eventBatch, ordered->time, ordered->event);
+    } else {
+      const std::time_t time =
+          std::chrono::system_clock::to_time_t(ordered->time);
+      std::tm local;
+      localtime_r(&time, &local);
+      std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %X", &local);
+
+      logBatch += timestamp;
+      logBatch += " [";
+      logBatch += levelName(ordered->level);
+      logBatch += "] - ";
+      logBatch += ordered->message;
+      logBatch += '\n';
+    }
+
+    Entry *done = ordered;
+    ordered = ordered->next;
+    delete done;
+  }
+
+  write(m_log, logBatch);
+  write(m_events, eventBatch);
+  m_written.fetch_add(count);
+  return true;
+}
+
+std::string SessionLogger::eventsPath(const std::string &directory,
+                                      int index) {
+  return outputPath(directory, kEventsName, kEventsExtension, index).string();
+}
+
+void SessionLogger::open(Output &output) {
+  const fs::path path =
+      outputPath(m_directory, output.name, output.extension, 0);
+  std::error_code error;
+  output.size = fs::file_size(path, error);
+  if (error) {
+    output.size = 0;
+  }
+  output.file.open(path, std::ios_base::app);
+}
+
+void SessionLogger::write(Output &output, const std::string &batch) {
+  if (batch.empty() || !output.file.is_open()) {
+    return;
+  }
+  output.file.write(batch.data(), batch.size());
+  output.file.flush();
+  output.size += batch.size();
+  if (output.size > output.maxBytes) {
+    rotate(output);
+  }
+}
+
+void SessionLogger::rotate(Output &output) {
+  output.file.close();
+
+  std::error_code error;
+  fs::remove(outputPath(m_directory, output.name, output.extension,
+                        kRotatedFiles),
+             error);
+  for (int index = kRotatedFiles - 1; index >= 0; --index) {
+    fs::rename(
+        outputPath(m_directory, output.name, output.extension, index),
+        outputPath(m_directory, output.name, output.extension, index + 1),
+        error);
+  }
+
+  open(output);
+}
@@ -0,0 +1,237 @@
+#include "session_stats.h"
+#include "session_logger.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr std::size_t kTopFiles = 10;
+
+struct TypeStats {
+  std::uint64_t count = 0;
+  std::vector<double> durations;
+};
+
+struct FileStats {
+  std::uint64_t loads = 0;
+  double totalMs = 0.0;
+  double maxMs = 0.0;
+  std::uint64_t failures = 0;
+  std::string lastError;
+};
+
+// Value position of "key": in `line`, or npos
+std::size_t findValue(std::string_view line, std::string_view key) {
+  std::size_t pos = 0;
+  while ((pos = line.find(key, pos)) != std::string_view::npos) {
+    const std::size_t end = pos + key.size();
+    if (pos > 0 && line[pos - 1] == '"' && end + 1 < line.size() &&
+        line[end] == '"' && line[end + 1] == ':') {
+      return end + 2;
+    }
+    pos = end;
+  }
+  return std::string_view::npos;
+}
+
+bool readString(std::string_view line, std::string_view key,
+                std::string &value) {
+  std::size_t pos = findValue(line, key);
+  if (pos == std::string_view::npos || line[pos] != '"') {
+    return false;
+  }
+  value.clear();
+  for (++pos; pos < line.size() && line[pos] != '"'; ++pos) {
+    if (line[pos] == '\\' && pos + 1 < line.size()) {
+      ++pos;
+      switch (line[pos]) {
+      case 'n':
+        value += '\n';
+        break;
+      case 'u':
+        // Only control characters are escaped this way
+        if (pos + 4 < line.size()) {
+          value += static_cast<char>(
+              std::strtol(std::string(line.substr(pos + 1, 4)).c_str(),
+                          nullptr, 16));
+          pos += 4;
+        }
+        break;
+      default:
+        value += line[pos];
+      }
+    } else {
+      value += line[pos];
+    }
+  }
+  return true;
+}
+
+bool readNumber(std::string_view line, std::string_view key, double &value) {
+  const std::size_t pos = findValue(line, key);
+  if (pos == std::string_view::npos) {
+    return false;
+  }
+  // Lines end in '}', so strtod always stops inside the line
+  char *end = nullptr;
+  value = std::strtod(line.data() + pos, &end);
+  return end != line.data() + pos;
+}
+
+double percentile(std::vector<double> &sorted, double fraction) {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+  const std::size_t index = std::min(
+      sorted.size() - 1, static_cast<std::size_t>(fraction * sorted.size()));
+  return sorted[index];
+}
+
+} // namespace
+
+int runSessionStats(const std::string &directory, std::ostream &out) {
+  // Rotated files first, so events are read oldest first
+  std::vector<fs::path> files;
+  for (int index = SessionLogger::kRotatedFiles; index >= 0; --index) {
+    const fs::path path = SessionLogger::eventsPath(directory, index);
+    if (fs::exists(path)) {
+      files.push_back(path);
+    }
+  }
+  if (files.empty()) {
+    out << "No events recorded in " << directory << "\n";
+    return 1;
+  }
+
+  std::map<std::string, TypeStats> types;
+  std::unordered_map<std::string, FileStats> perFile;
+  std::uint64_t events = 0;
+  std::uint64_t malformed = 0;
+
+  std::string line;
+  std::string type;
+  std::string file;
+  std::string error;
+  std::vector<char> buffer(1 << 20);
+  for (const fs::path &path : files) {
+    std::ifstream input;
+    input.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+    input.open(path);
+    while (std::getline(input, line)) {
+      if (line.empty() || line.back() != '}' ||
+          !readString(line, "type", type)) {
+        ++malformed;
+        continue;
+      }
+      ++events;
+
+      TypeStats &stats = types[type];
+      ++stats.count;
+      double ms = 0.0;
+      const bool hasMs = readNumber(line, "ms", ms);
+      if (hasMs) {
+        stats.durations.push_back(ms);
+      }
+
+      if (!readString(line, "file", file)) {
+        continue;
+      }
+      if (type == "load" && hasMs) {
+        FileStats &fileStats = perFile[file];
+        ++fileStats.loads;
+        fileStats.totalMs += ms;
+        fileStats.maxMs = std::max(fileStats.maxMs, ms);
+      } else if (type == "load_error") {
+        FileStats &fileStats = perFile[file];
+        ++fileStats.failures;
+        if (readString(line, "error", error)) {
+          fileStats.lastError = error;
+        }
+      }
+    }
+  }
+
+  char row[512];
+  out << events << " events";
+  if (malformed > 0) {
+    out << " (" << malformed << " malformed lines skipped)";
+  }
+  out << "\n\n";
+
+  std::snprintf(row, sizeof(row), "%-14s %10s %10s %10s %10s %10s\n", "type",
+                "count", "avg ms", "p50 ms", "p95 ms", "max ms");
+  out << row;
+  for (auto &[name, stats] : types) {
+    std::vector<double> &durations = stats.durations;
+    std::sort(durations.begin(), durations.end());
+    double total = 0.0;
+    for (const double ms : durations) {
+      total += ms;
+    }
+    if (durations.empty()) {
+      std::snprintf(row, sizeof(row), "%-14s %10llu\n", name.c_str(),
+                    static_cast<unsigned long long>(stats.count));
+    } else {
+      std::snprintf(row, sizeof(row),
+                    "%-14s %10llu %10.1f %10.1f %10.1f %10.1f\n", name.c_str(),
+                    static_cast<unsigned long long>(stats.count),
+                    total / durations.size(), percentile(durations, 0.5),
+                    percentile(durations, 0.95), durations.back());
+    }
+    out << row;
+  }
+
+  std::vector<std::pair<std::string, const FileStats *>> slowest;
+  std::vector<std::pair<std::string, const FileStats *>> failed;
+  for (const auto &[name, stats] : perFile) {
+    if (stats.loads > 0) {
+      slowest.emplace_back(name, &stats);
+    }
+    if (stats.failures > 0) {
+      failed.emplace_back(name, &stats);
+    }
+  }
+
+  if (!slowest.empty()) {
+    const std::size_t shown = std::min(kTopFiles, slowest.size());
+    std::partial_sort(slowest.begin(), slowest.begin() + shown, slowest.end(),
+                      [](const auto &a, const auto &b) {
+                        return a.second->totalMs / a.second->loads >
+                               b.second->totalMs / b.second->loads;
+                      });
+    out << "\nSlowest loads:\n";
+    std::snprintf(row, sizeof(row), "%10s %10s %8s  %s\n", "avg ms", "max ms",
+                  "loads", "file");
+    out << row;
+    for (std::size_t i = 0; i < shown; ++i) {
+      const FileStats &stats = *slowest[i].second;
+      std::snprintf(row, sizeof(row), "%10.1f %10.1f %8llu  ",
+                    stats.totalMs / stats.loads, stats.maxMs,
+                    static_cast<unsigned long long>(stats.loads));
+      out << row << slowest[i].first << "\n";
+    }
+  }
+
+  if (!failed.empty()) {
+    const std::size_t shown = std::min(kTopFiles, failed.size());
+    std::partial_sort(failed.begin(), failed.begin() + shown, failed.end(),
+                      [](const auto &a, const auto &b) {
+                        return a.second->failures > b.second->failures;
+                      });
+    out << "\nFailed files:\n";
+    for (std::size_t i = 0; i < shown; ++i) {
+      out << "  " << failed[i].second->failures << "x " << failed[i].first
+          << ": " << failed[i].second->lastError << "\n";
+    }
+  }
+  return 0;
+}
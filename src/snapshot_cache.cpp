@@ -0,0 +1,43 @@
+#include "snapshot_cache.h"
+#include <cmath>
+
+SnapshotCache::SnapshotCache(qint64 maxBytes) : m_devicePixelRatio(1.0) {
+  setMaxBytes(maxBytes);
+}
+
+void SnapshotCache::setMaxBytes(qint64 bytes) {
+  m_snapshots.setMaxCost(qMax<qint64>(1, bytes / 1024));
+}
+
+void SnapshotCache::setViewport(const QSize &size, qreal devicePixelRatio) {
+  m_viewportSize = size;
+  m_devicePixelRatio = devicePixelRatio;
+}
+
+void SnapshotCache::insert(int index, const Snapshot &snapshot) {
+  const QPixmap &pixmap = snapshot.pixmap;
+  const qint64 cost = qMax<qint64>(
+      1, qint64(pixmap.width()) * pixmap.height() * 4 / 1024);
+  m_snapshots.insert(key(index), new Snapshot(snapshot), cost);
+}
+
+qint64 SnapshotCache::viewportCost() const {
+  const qint64 width = std::ceil(m_viewportSize.width() * m_devicePixelRatio);
+  const qint64 height =
+      std::ceil(m_viewportSize.height() * m_devicePixelRatio);
+  return qMax<qint64>(1, width * height * 4 / 1024);
+}
+
+bool SnapshotCache::hasRoomForAnother() const {
+  // Snapshots of other viewports were last used before the switch to this
+  // one, so they are the first to be evicted
+  qint64 used = 0;
+  const QList<Key> keys = m_snapshots.keys();
+  for (const Key &cached : keys) {
+    if (cached.size == m_viewportSize &&
+        cached.devicePixelRatio == m_devicePixelRatio) {
+      used += viewportCost();
+    }
+  }
+  return used + viewportCost() <= m_snapshots.maxCost();
+}
@@ -0,0 +1,51 @@
+#include "startup_trace.h"
+#include <QElapsedTimer>
+#include <utility>
+#include <vector>
+
+namespace {
+
+QElapsedTimer &clock() {
+  static QElapsedTimer timer;
+  return timer;
+}
+
+std::vector<std::pair<QString, qint64>> &marks() {
+  static std::vector<std::pair<QString, qint64>> phases;
+  return phases;
+}
+
+} // namespace
+
+void StartupTrace::start() {
+  clock().start();
+  marks().clear();
+}
+
+void StartupTrace::mark(const QString &phase) {
+  if (clock().isValid()) {
+    marks().emplace_back(phase, clock().nsecsElapsed());
+  }
+}
+
+qreal StartupTrace::elapsedMs(const QString &phase) {
+  for (const auto &[name, nsecs] : marks()) {
+    if (name == phase) {
+      return nsecs / 1e6;
+    }
+  }
+  return -1.0;
+}
+
+QString StartupTrace::report() {
+  QString text = "Startup trace (ms since main, ms in phase):\n";
+  qint64 previous = 0;
+  for (const auto &[name, nsecs] : marks()) {
+    text += QString("  %1 %2 %3\n")
+                .arg(name, -24)
+                .arg(nsecs / 1e6, 9, 'f', 2)
+                .arg((nsecs - previous) / 1e6, 9, 'f', 2);
+    previous = nsecs;
+  }
+  return text;
+}
@@ -0,0 +1,227 @@
+#include "state_store.h"
+#include "utils.h"
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+using nlohmann::json;
+
+namespace {
+
+// Changes are saved once none has come in for this long
+constexpr std::chrono::milliseconds kDebounce(500);
+
+json::json_pointer pointerFor(const std::string &key) {
+  return json::json_pointer("/" + key);
+}
+
+bool parseEnv(const std::string &text, std::uint64_t &value) {
+  try {
+    std::size_t end = 0;
+    value = std::stoull(text, &end);
+    return end == text.size();
+  } catch (const std::exception &) {
+    return false;
+  }
+}
+
+bool parseEnv(const std::string &text, bool &value) {
+  if (text == "1" || text == "true" || text == "yes" || text == "on") {
+    value = true;
+  } else if (text == "0" || text == "false" || text == "no" ||
+             text == "off" || text.empty()) {
+    value = false;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool parseEnv(const std::string &text, std::string &value) {
+  value = text;
+  return true;
+}
+
+} // namespace
+
+StateStore &StateStore::instance() {
+  static StateStore store(
+      (fs::path(utils::ensure_neat_directory()) / "state.json").string());
+  return store;
+}
+
+StateStore::StateStore(const std::string &filePath)
+    : m_filePath(filePath), m_state(readFile(filePath)), m_saving(false),
+      m_flushRequested(false), m_stopping(false) {
+  m_thread = std::thread(&StateStore::run, this);
+}
+
+StateStore::~StateStore() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_changed.notify_one();
+  m_thread.join();
+}
+
+json StateStore::readFile(const std::string &filePath) {
+  std::ifstream file(filePath);
+  if (!file) {
+    return json::object();
+  }
+  json state = json::parse(file, nullptr, false);
+  if (state.is_discarded() || !state.is_object()) {
+    std::cerr << "Ignoring unreadable state file: " << filePath << std::endl;
+    return json::object();
+  }
+  return state;
+}
+
+template <typename T>
+T StateStore::value(const std::string &key, const T &fallback) const {
+  const json::json_pointer pointer = pointerFor(key);
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_state.contains(pointer)) {
+    return fallback;
+  }
+  try {
+    return m_state.at(pointer).get<T>();
+  } catch (const json::exception &) {
+    return fallback;
+  }
+}
+
+template <typename T>
+void StateStore::setValue(const std::string &key, const T &value) {
+  json stored = value;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    json &slot = m_state[pointerFor(key)];
+    if (slot == stored) {
+      return;
+    }
+    slot = std::move(stored);
+    m_dirty.insert(key);
+    m_lastChange = std::chrono::steady_clock::now();
+  }
+  m_changed.notify_one();
+}
+
+template <typename T> T StateStore::setting(const Setting<T> &setting) const {
+  const T stored =
+      value<T>(std::string("settings/") + setting.key, setting.defaultValue);
+  if (const char *configured = std::getenv(setting.envVar)) {
+    T overridden;
+    if (parseEnv(configured, overridden)) {
+      return overridden;
+    }
+    std::cerr << "Ignoring invalid " << setting.envVar << ": " << configured
+              << std::endl;
+  }
+  return stored;
+}
+
+template std::string StateStore::value(const std::string &,
+                                       const std::string &) const;
+template bool StateStore::value(const std::string &, const bool &) const;
+template std::uint64_t StateStore::value(const std::string &,
+                                         const std::uint64_t &) const;
+template std::vector<std::string>
+StateStore::value(const std::string &, const std::vector<std::string> &) const;
+template void StateStore::setValue(const std::string &, const std::string &);
+template void StateStore::setValue(const std::string &, const bool &);
+template void StateStore::setValue(const std::string &,
+                                   const std::uint64_t &);
+template void StateStore::setValue(const std::string &,
+                                   const std::vector<std::string> &);
+template std::string StateStore::setting(const Setting<std::string> &) const;
+template bool StateStore::setting(const Setting<bool> &) const;
+template std::uint64_t
+StateStore::setting(const Setting<std::uint64_t> &) const;
+
+void StateStore::flush() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if (m_dirty.empty() && !m_saving) {
+    return;
+  }
+  m_flushRequested = true;
+  m_changed.notify_one();
+  m_saved.wait(lock, [this]() { return m_dirty.empty() && !m_saving; });
+}
+
+void StateStore::run() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    m_changed.wait(lock, [this]() { return m_stopping || !m_dirty.empty(); });
+
+    // Let a burst of changes settle into one write
+    while (!m_stopping && !m_flushRequested &&
+           std::chrono::steady_clock::now() - m_lastChange < kDebounce) {
+      m_changed.wait_until(lock, m_lastChange + kDebounce);
+    }
+    m_flushRequested = false;
+
+    if (!m_dirty.empty()) {
+      save(lock);
+    }
+    m_saved.notify_all();
+
+    if (m_stopping && m_dirty.empty()) {
+      break;
+    }
+  }
+}
+
+void StateStore::save(std::unique_lock<std::mutex> &lock) {
+  // Keys a failed save left behind go out with this one
+  m_dirty.insert(m_unsaved.begin(), m_unsaved.end());
+  m_unsaved.clear();
+  std::vector<std::pair<std::string, json>> changes;
+  for (const std::string &key : m_dirty) {
+    changes.emplace_back(key, m_state.at(pointerFor(key)));
+  }
+  m_dirty.clear();
+  m_saving = true;
+  lock.unlock();
+
+  // Whatever is on disk now, with our changes on top
+  json state = readFile(m_filePath);
+  for (auto &[key, value] : changes) {
+    state[pointerFor(key)] = std::move(value);
+  }
+
+  // Per process, so two instances never write into the same file
+  const std::string temporary =
+      m_filePath + ".tmp." + std::to_string(getpid());
+  bool written;
+  {
+    std::ofstream file(temporary, std::ios::trunc);
+    file << state.dump(4);
+    file.close();
+    written = file.good();
+  }
+  std::error_code error;
+  if (written) {
+    fs::rename(temporary, m_filePath, error);
+  }
+  // A short write (disk full, I/O error) must not replace the old file
+  const bool saved = written && !error;
+  if (!saved) {
+    std::cerr << "Could not save " << m_filePath << ": "
+              << (written ? error.message() : "write failed") << std::endl;
+    fs::remove(temporary, error);
+  }
+
+  lock.lock();
+  if (!saved) {
+    // Retried with the next change rather than in a loop
+    for (const auto &change : changes) {
+      m_unsaved.insert(change.first);
+    }
+  }
+  m_saving = false;
+}
@@ -0,0 +1,218 @@
+#include "tile_pyramid.h"
+#include "raster_conversion.h"
+#include <QMutexLocker>
+#include <QPainter>
+#include <QPromise>
+#include <QStyleOptionGraphicsItem>
+#include <QtConcurrent/QtConcurrentRun>
+#include <cmath>
+
+namespace {
+
+// Default bound for decoded tiles kept in memory, in KiB
+constexpr int kTileCacheCost = 256 * 1024;
+
+quint64 tileKey(int level, int tileX, int tileY) {
+  return (static_cast<quint64>(level) << 56) |
+         (static_cast<quint64>(tileY) << 28) | static_cast<quint64>(tileX);
+}
+
+} // namespace
+
+TilePyramid::TilePyramid(std::shared_ptr<ImageDecoder> decoder)
+    : m_decoder(std::move(decoder)), m_size(m_decoder->size()),
+      m_maxLevel(0), m_tiles(kTileCacheCost) {
+  // The coarsest level is the first one that fits in a single tile
+  while (((m_size.width() - 1) >> m_maxLevel) >= kTileSize ||
+         ((m_size.height() - 1) >> m_maxLevel) >= kTileSize) {
+    ++m_maxLevel;
+  }
+}
+
+void TilePyramid::setCacheLimit(qint64 bytes) {
+  QMutexLocker locker(&m_tilesMutex);
+  m_tiles.setMaxCost(qMax<qint64>(1, bytes / 1024));
+}
+
+int TilePyramid::levelForScale(qreal scale) const {
+  if (scale >= 1.0) {
+    return 0;
+  }
+  // Pick the finest level that is still at least as dense as the screen
+  int level = static_cast<int>(std::floor(std::log2(1.0 / scale)));
+  return qBound(0, level, m_maxLevel);
+}
+
+int TilePyramid::levelForPaint(qreal scale, bool draft) const {
+  return qMin(levelForScale(scale) + (draft ? 1 : 0), m_maxLevel);
+}
+
+QRect TilePyramid::tileRange(int level, const QRectF &region) const {
+  const QRectF clipped = region.intersected(QRectF(QPointF(0, 0), m_size));
+  if (clipped.isEmpty()) {
+    return QRect();
+  }
+  const int span = kTileSize << level;
+  const int firstX = static_cast<int>(std::floor(clipped.left() / span));
+  const int firstY = static_cast<int>(std::floor(clipped.top() / span));
+  const int lastX = static_cast<int>(std::ceil(clipped.right() / span)) - 1;
+  const int lastY = static_cast<int>(std::ceil(clipped.bottom() / span)) - 1;
+  return QRect(QPoint(firstX, firstY), QPoint(lastX, lastY));
+}
+
+QRect TilePyramid::tileSourceRect(int level, int tileX, int tileY) const {
+  const int span = kTileSize << level;
+  return QRect(tileX * span, tileY * span, span, span)
+      .intersected(QRect(QPoint(0, 0), m_size));
+}
+
+QImage TilePyramid::cachedTile(quint64 key) const {
+  QMutexLocker locker(&m_tilesMutex);
+  const QImage *cached = m_tiles.object(key);
+  return cached ? *cached : QImage();
+}
+
+QImage TilePyramid::tile(int level, int tileX, int tileY) {
+  const quint64 key = tileKey(level, tileX, tileY);
+  QMutexLocker locker(&m_tilesMutex);
+  if (const QImage *cached = m_tiles.object(key)) {
+    return *cached;
+  }
+  // Bands of a parallel frame often share a tile; only the first one to
+  // ask decodes it
+  const auto decoding = m_decoding.constFind(key);
+  if (decoding != m_decoding.cend()) {
+    QFuture<QImage> pending = *decoding;
+    locker.unlock();
+    pending.waitForFinished();
+    return pending.resultCount() > 0 ? pending.result() : QImage();
+  }
+  QPromise<QImage> promise;
+  m_decoding.insert(key, promise.future());
+  locker.unlock();
+
+  // Decoded without holding the lock, so other threads keep drawing cached
+  // tiles meanwhile
+  promise.start();
+  const QImage image = decodeTile(level, tileX, tileY);
+  if (!image.isNull()) {
+    promise.addResult(image);
+  }
+
+  locker.relock();
+  if (!image.isNull()) {
+    const qsizetype cost = qMax<qsizetype>(1, image.sizeInBytes() / 1024);
+    m_tiles.insert(key, new QImage(image), cost);
+  }
+  m_decoding.remove(key);
+  locker.unlock();
+  promise.finish();
+  return image;
+}
+
+QImage TilePyramid::decodeTile(int level, int tileX, int tileY) const {
+  const QRect source = tileSourceRect(level, tileX, tileY);
+  const int round = (1 << level) - 1;
+  const QSize scaledSize((source.width() + round) >> level,
+                         (source.height() + round) >> level);
+
+  if (level == 0 || m_decoder->supports(ImageDecoder::ScaledDecode)) {
+    return toDisplayFormat(m_decoder->read(source, scaledSize));
+  }
+  // Build the level from a full-resolution decode of the region with
+  // the box-filter kernels rather than QImageReader's generic scaling
+  QImage image = toDisplayFormat(m_decoder->read(source));
+  for (int i = 0; i < level && !image.isNull(); ++i) {
+    image = downsample2x(image);
+  }
+  return image;
+}
+
+bool TilePyramid::drawCachedTile(QPainter *painter, int level, int tileX,
+                                 int tileY) {
+  const QRect target = tileSourceRect(level, tileX, tileY);
+  for (int coarser = level; coarser <= m_maxLevel; ++coarser) {
+    const int shift = coarser - level;
+    const int coarseX = tileX >> shift;
+    const int coarseY = tileY >> shift;
+    const QImage cached = cachedTile(tileKey(coarser, coarseX, coarseY));
+    if (cached.isNull()) {
+      continue;
+    }
+
+    // The part of the coarser tile covering this one, in its own pixels
+    const QPoint origin = tileSourceRect(coarser, coarseX, coarseY).topLeft();
+    const qreal factor = 1.0 / (1 << coarser);
+    const QRectF source(QPointF(target.topLeft() - origin) * factor,
+                        QSizeF(target.size()) * factor);
+    painter->drawImage(QRectF(target), cached, source);
+    return true;
+  }
+  return false;
+}
+
+void TilePyramid::prefetch(const QRectF &region, qreal scale, bool draft) {
+  const int level = levelForPaint(scale, draft);
+  const QRect range = tileRange(level, region);
+  QMutexLocker locker(&m_tilesMutex);
+  for (int tileY = range.top(); tileY <= range.bottom(); ++tileY) {
+    for (int tileX = range.left(); tileX <= range.right(); ++tileX) {
+      const quint64 key = tileKey(level, tileX, tileY);
+      if (m_tiles.contains(key) || m_prefetchQueued.contains(key)) {
+        continue;
+      }
+      m_prefetchQueued.insert(key);
+      m_prefetchQueue.push_back({level, tileX, tileY});
+    }
+  }
+}
+
+QFuture<void> TilePyramid::prefetchNext() {
+  const TileId id = m_prefetchQueue.front();
+  m_prefetchQueue.pop_front();
+  m_prefetchQueued.remove(tileKey(id.level, id.x, id.y));
+  // Keeps the pyramid alive even if its item is deleted meanwhile
+  return QtConcurrent::run(
+      [self = shared_from_this(), id]() { self->tile(id.level, id.x, id.y); });
+}
+
+void TilePyramid::prefetchAll(const std::function<bool()> &stop) {
+  for (const TileId &id : m_prefetchQueue) {
+    if (stop && stop()) {
+      break;
+    }
+    tile(id.level, id.x, id.y);
+  }
+  clearPrefetch();
+}
+
+void TilePyramid::clearPrefetch() {
+  m_prefetchQueue.clear();
+  m_prefetchQueued.clear();
+}
+
+void TilePyramid::paint(QPainter *painter, const QRectF &exposed) {
+  // Levels are picked for device pixels: on a 2x screen a view zoom of 0.5
+  // still shows every image pixel
+  const qreal dpr =
+      painter->device() ? painter->device()->devicePixelRatioF() : 1.0;
+  const qreal scale =
+      dpr * QStyleOptionGraphicsItem::levelOfDetailFromTransform(
+                painter->worldTransform());
+  const bool draft =
+      !painter->testRenderHint(QPainter::SmoothPixmapTransform);
+  const int level = levelForPaint(scale, draft);
+  const QRect range = tileRange(level, exposed);
+
+  for (int tileY = range.top(); tileY <= range.bottom(); ++tileY) {
+    for (int tileX = range.left(); tileX <= range.right(); ++tileX) {
+      if (draft && drawCachedTile(painter, level, tileX, tileY)) {
+        continue;
+      }
+      QImage image = tile(level, tileX, tileY);
+      if (!image.isNull()) {
+        painter->drawImage(QRectF(tileSourceRect(level, tileX, tileY)), image);
+      }
+    }
+  }
+}
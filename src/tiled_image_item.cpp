@@ -0,0 +1,26 @@
+#include "tiled_image_item.h"
+#include <QStyleOptionGraphicsItem>
+
+TiledImageItem::TiledImageItem(std::shared_ptr<ImageDecoder> decoder,
+                               QGraphicsItem *parent)
+    : TiledImageItem(std::make_shared<TilePyramid>(std::move(decoder)),
+                     parent) {}
+
+TiledImageItem::TiledImageItem(std::shared_ptr<TilePyramid> pyramid,
+                               QGraphicsItem *parent)
+    : QGraphicsItem(parent), m_pyramid(std::move(pyramid)) {
+  // Needed for option->exposedRect to hold the exposed area rather than
+  // the whole bounding rect
+  setFlag(QGraphicsItem::ItemUsesExtendedStyleOption, true);
+}
+
+QRectF TiledImageItem::boundingRect() const {
+  return QRectF(QPointF(0, 0), m_pyramid->size());
+}
+
+void TiledImageItem::paint(QPainter *painter,
+                           const QStyleOptionGraphicsItem *option,
+                           QWidget *widget) {
+  Q_UNUSED(widget);
+  m_pyramid->paint(painter, option->exposedRect);
+}
@@ -1,15 +1,17 @@
 #include "utils.h"
-#include "json.hpp"
+#include "session_logger.h"
+#include "state_store.h"
+#include <algorithm>
 #include <ctime>
 #include <filesystem>
 #include <fstream>
-#include <iomanip>
 #include <iostream>
+#include <limits>
 #include <limits.h>
+#include <sstream>
 #include <unistd.h>
 
 namespace fs = std::filesystem;
-namespace json = nlohmann::json_abi_v3_11_3;
 
 namespace utils {
 
@@ -40,48 +42,142 @@ std::string ensure_neat_directory() {
 
 void save_state(const std::string &file_path, const std::string &last_folder,
                 const std::vector<std::string> &recent_files) {
-  std::string neat_dir = ensure_neat_directory();
-  fs::path state_file = fs::path(neat_dir) / "state.json";
+  // Only updates the in-memory state; the store writes it out later
+  StateStore &store = StateStore::instance();
+  store.setValue("last_opened_file", file_path);
+  store.setValue("last_accessed_folder", last_folder);
+  store.setValue("recent_files", recent_files);
+}
 
-  json::json state = {{"last_opened_file", file_path},
-                      {"last_accessed_folder", last_folder},
-                      {"recent_files", recent_files}};
+std::tuple<std::string, std::string, std::vector<std::string>> load_state() {
+  const StateStore &store = StateStore::instance();
+  return std::make_tuple(
+      store.value<std::string>("last_opened_file", ""),
+      store.value<std::string>("last_accessed_folder", ""),
+      store.value<std::vector<std::string>>("recent_files", {}));
+}
 
-  std::ofstream file(state_file);
-  file << state.dump(4);
+void log_session(const std::string &message) {
+  log_session(LogLevel::Info, message);
 }
 
-std::tuple<std::string, std::string, std::vector<std::string>> load_state() {
-  std::string neat_dir = ensure_neat_directory();
-  fs::path state_file = fs::path(neat_dir) / "state.json";
-
-  if (fs::exists(state_file)) {
-    std::ifstream file(state_file);
-    json::json state;
-    file >> state;
-
-    return std::make_tuple(
-        state["last_opened_file"].get<std::string>(),
-        state["last_accessed_folder"].get<std::string>(),
-        state["recent_files"].get<std::vector<std::string>>());
+void log_session(LogLevel level, const std::string &message) {
+  SessionLogger::instance().log(level, message);
+}
+
+void log_event(SessionEvent event) {
+  SessionLogger::instance().event(std::move(event));
+}
+
+namespace {
+
+// Reads the first integer from a file such as a cgroup control file.
+// Returns false for missing files and for "max" (no limit).
+bool read_uint64(const fs::path &path, std::uint64_t &value) {
+  std::ifstream file(path);
+  std::string token;
+  if (!(file >> token) || token == "max") {
+    return false;
+  }
+  try {
+    value = std::stoull(token);
+  } catch (const std::exception &) {
+    return false;
+  }
+  return true;
+}
+
+// Memory still available to this process's cgroup (v2, then v1)
+std::uint64_t cgroup_available_bytes() {
+  std::uint64_t limit = 0;
+  std::uint64_t usage = 0;
+
+  std::ifstream cgroup_file("/proc/self/cgroup");
+  std::string line;
+  while (std::getline(cgroup_file, line)) {
+    if (line.rfind("0::", 0) == 0) {
+      fs::path dir = fs::path("/sys/fs/cgroup") / line.substr(4);
+      if (read_uint64(dir / "memory.max", limit) &&
+          read_uint64(dir / "memory.current", usage)) {
+        return limit > usage ? limit - usage : 0;
+      }
+    }
   }
 
-  return std::make_tuple("", "", std::vector<std::string>());
+  if (read_uint64("/sys/fs/cgroup/memory/memory.limit_in_bytes", limit) &&
+      read_uint64("/sys/fs/cgroup/memory/memory.usage_in_bytes", usage)) {
+    return limit > usage ? limit - usage : 0;
+  }
+
+  return std::numeric_limits<std::uint64_t>::max();
 }
 
-void log_session(const std::string &message) {
-  std::string neat_dir = ensure_neat_directory();
-  fs::path log_file = fs::path(neat_dir) / "log.txt";
+// Reads a "Name:   123 kB" field from /proc/self/status, in bytes
+std::uint64_t read_status_bytes(const std::string &name) {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    std::istringstream fields(line);
+    std::string key;
+    std::uint64_t kib = 0;
+    if (fields >> key >> kib && key == name + ":") {
+      return kib * 1024;
+    }
+  }
+  return 0;
+}
+
+} // namespace
+
+std::uint64_t available_memory_bytes() {
+  std::uint64_t available = std::numeric_limits<std::uint64_t>::max();
+
+  std::ifstream meminfo("/proc/meminfo");
+  std::string line;
+  while (std::getline(meminfo, line)) {
+    std::istringstream fields(line);
+    std::string key;
+    std::uint64_t kib = 0;
+    if (fields >> key >> kib && key == "MemAvailable:") {
+      available = kib * 1024;
+      break;
+    }
+  }
 
-  std::ofstream file(log_file, std::ios_base::app);
+  return std::min(available, cgroup_available_bytes());
+}
+
+std::uint64_t image_memory_budget_bytes() {
+  // Never plan to use more than half of what is left, so the rest of the
+  // system (and our own tile caches) keep some headroom
+  std::uint64_t budget = available_memory_bytes() / 2;
+
+  // The memory_budget_mb setting (or NEAT_MEMORY_BUDGET_MB) caps the budget
+  // further
+  const std::uint64_t configured =
+      StateStore::instance().setting(settings::memoryBudgetMb);
+  if (configured > 0) {
+    budget = std::min<std::uint64_t>(budget, configured * 1024 * 1024);
+  }
+
+  return budget;
+}
+
+std::uint64_t decode_cache_max_bytes() {
+  // The decode_cache_mb setting (or NEAT_DECODE_CACHE_MB); 0 disables the
+  // cache
+  return StateStore::instance().setting(settings::decodeCacheMb) * 1024 *
+         1024;
+}
 
-  auto now = std::chrono::system_clock::now();
-  auto in_time_t = std::chrono::system_clock::to_time_t(now);
+std::uint64_t current_rss_bytes() { return read_status_bytes("VmRSS"); }
 
-  std::stringstream ss;
-  ss << std::put_time(std::localtime(&in_time_t), "%Y-%m-%d %X");
+std::uint64_t peak_rss_bytes() { return read_status_bytes("VmHWM"); }
 
-  file << ss.str() << " - " << message << std::endl;
+void reset_peak_rss() {
+  // Writing 5 to clear_refs resets VmHWM to the current RSS (Linux >= 4.0)
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  clear_refs << "5";
 }
 
 QStringList stdVectorToQStringList(const std::vector<std::string> &vec) {
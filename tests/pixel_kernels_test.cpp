@@ -0,0 +1,206 @@
+// Checks the dispatched pixel kernels bit-exact against the scalar
+// reference. The instruction set to test is given on the command line
+// (scalar, sse2 or avx2); exits with 77 when the CPU does not support it.
+#include "pixel_kernels.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace pixel_kernels;
+
+namespace {
+
+constexpr int kSkipped = 77;
+
+std::mt19937 rng(12345);
+int failures = 0;
+
+std::uint32_t randomPixel() {
+  const std::uint32_t pixel = rng();
+  // Fully transparent and opaque pixels take their own paths in some
+  // callers; make sure both show up often
+  switch (rng() % 4) {
+  case 0:
+    return pixel & 0x00ffffffu;
+  case 1:
+    return pixel | 0xff000000u;
+  default:
+    return pixel;
+  }
+}
+
+template <typename T>
+bool expectEqual(const char *kernel, const std::string &params, const T *got,
+                 const T *expected, std::size_t count) {
+  for (std::size_t i = 0; i < count; ++i) {
+    if (got[i] != expected[i]) {
+      std::cerr << kernel << " (" << params << "): mismatch at " << i
+                << ": got 0x" << std::hex << std::uint64_t(got[i])
+                << ", expected 0x" << std::uint64_t(expected[i]) << std::dec
+                << std::endl;
+      ++failures;
+      return false;
+    }
+  }
+  return true;
+}
+
+// Counts around each vector width and its tail handling, plus a long run
+std::vector<int> testCounts() {
+  std::vector<int> counts;
+  for (int count = 0; count <= 70; ++count) {
+    counts.push_back(count);
+  }
+  counts.push_back(1021);
+  counts.push_back(1024);
+  return counts;
+}
+
+void testRgb888ToArgb32() {
+  for (int count : testCounts()) {
+    // Source offsets break the alignment of every 3-byte group, the
+    // destination offset that of the 32-bit stores
+    for (int srcOffset = 0; srcOffset < 4; ++srcOffset) {
+      for (int dstOffset = 0; dstOffset < 2; ++dstOffset) {
+        std::vector<std::uint8_t> src(std::size_t(count) * 3 + srcOffset);
+        for (std::uint8_t &byte : src) {
+          byte = std::uint8_t(rng());
+        }
+        std::vector<std::uint32_t> got(count + dstOffset, 0xdeadbeef);
+        std::vector<std::uint32_t> expected(got);
+
+        rgb888ToArgb32(src.data() + srcOffset, got.data() + dstOffset, count);
+        reference::rgb888ToArgb32(src.data() + srcOffset,
+                                  expected.data() + dstOffset, count);
+        if (!expectEqual("rgb888ToArgb32",
+                         "count " + std::to_string(count) + ", offsets " +
+                             std::to_string(srcOffset) + "/" +
+                             std::to_string(dstOffset),
+                         got.data(), expected.data(), got.size())) {
+          return;
+        }
+      }
+    }
+  }
+}
+
+void testPremultiplyArgb32() {
+  for (int count : testCounts()) {
+    for (int offset = 0; offset < 2; ++offset) {
+      std::vector<std::uint32_t> src(count + offset);
+      for (std::uint32_t &pixel : src) {
+        pixel = randomPixel();
+      }
+      std::vector<std::uint32_t> got(src.size(), 0xdeadbeef);
+      std::vector<std::uint32_t> expected(got);
+      const std::string params =
+          "count " + std::to_string(count) + ", offset " +
+          std::to_string(offset);
+
+      premultiplyArgb32(src.data() + offset, got.data() + offset, count);
+      reference::premultiplyArgb32(src.data() + offset,
+                                   expected.data() + offset, count);
+      if (!expectEqual("premultiplyArgb32", params, got.data(),
+                       expected.data(), got.size())) {
+        return;
+      }
+
+      // In place
+      premultiplyArgb32(src.data() + offset, src.data() + offset, count);
+      std::copy(src.begin(), src.begin() + offset, expected.begin());
+      if (!expectEqual("premultiplyArgb32", params + ", in place",
+                       src.data(), expected.data(), src.size())) {
+        return;
+      }
+    }
+  }
+}
+
+void testDownsample2xArgb32() {
+  std::vector<int> widths;
+  for (int width = 1; width <= 40; ++width) {
+    widths.push_back(width);
+  }
+  widths.push_back(1023);
+
+  for (int width : widths) {
+    for (int height = 1; height <= 5; ++height) {
+      // Row padding in pixels; odd paddings leave the rows of both images
+      // unaligned to any vector width
+      for (int padding : {0, 1, 3}) {
+        const int dstWidth = (width + 1) / 2;
+        const int dstHeight = (height + 1) / 2;
+        const int srcStride = (width + padding) * 4;
+        const int dstStride = (dstWidth + padding) * 4;
+
+        // One leading pixel so the first row is unaligned too
+        std::vector<std::uint32_t> src(1 + std::size_t(height) *
+                                               (width + padding));
+        for (std::uint32_t &pixel : src) {
+          pixel = randomPixel();
+        }
+        std::vector<std::uint32_t> got(1 + std::size_t(dstHeight) *
+                                               (dstWidth + padding),
+                                       0xdeadbeef);
+        std::vector<std::uint32_t> expected(got);
+
+        downsample2xArgb32(src.data() + 1, srcStride, width, height,
+                           got.data() + 1, dstStride);
+        reference::downsample2xArgb32(src.data() + 1, srcStride, width,
+                                      height, expected.data() + 1,
+                                      dstStride);
+        if (!expectEqual("downsample2xArgb32",
+                         std::to_string(width) + "x" +
+                             std::to_string(height) + ", padding " +
+                             std::to_string(padding),
+                         got.data(), expected.data(), got.size())) {
+          return;
+        }
+      }
+    }
+  }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  const std::string requested = argc > 1 ? argv[1] : "";
+  Isa isa;
+  // The kernels are picked on first use, honouring NEAT_PIXEL_ISA
+  if (requested == "scalar") {
+    isa = Isa::Scalar;
+    setenv("NEAT_PIXEL_ISA", "scalar", 1);
+  } else if (requested == "sse2") {
+    isa = Isa::SSE2;
+    setenv("NEAT_PIXEL_ISA", "sse2", 1);
+  } else if (requested == "avx2") {
+    isa = Isa::AVX2;
+    setenv("NEAT_PIXEL_ISA", "avx2", 1);
+  } else {
+    std::cerr << "Usage: " << argv[0] << " scalar|sse2|avx2" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (activeIsa() != isa) {
+    std::cout << isaName(isa) << " is not supported here, using "
+              << isaName(activeIsa()) << "; skipping" << std::endl;
+    return kSkipped;
+  }
+
+  testRgb888ToArgb32();
+  testPremultiplyArgb32();
+  testDownsample2xArgb32();
+
+  if (failures > 0) {
+    std::cerr << failures << " kernel(s) differ from the reference with "
+              << isaName(isa) << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "All kernels match the reference with " << isaName(isa)
+            << std::endl;
+  return EXIT_SUCCESS;
+}